@@ -0,0 +1,617 @@
+//Headless broadphase benchmark: QuadTree path (strict and loose bounds), LinearQuadTree, SpatialHashGrid, SweepAndPrune and brute force (CheckForNonQTCollisions(true)).
+//Only needs the collision core plus the header-only Engine/SFMLMath and SFML/System, e.g.
+//	g++ -std=c++17 -O2 -I.. -I<engine source root> -I<sfml>/include CollisionBenchmark.cpp ../CollisionManager.cpp ../CollisionKernels.cpp ../LinearQuadTree.cpp ../SpatialHashGrid.cpp ../SweepAndPrune.cpp ../CollisionJobSystem.cpp ../StaticCollisionIndex.cpp ../CollisionStats.cpp ../CollisionProfiler.cpp ../CollisionReplay.cpp -pthread -o CollisionBenchmark
+//add -DCOLLISION_PROFILING for --trace-dir
+//
+//usage: CollisionBenchmark [--scenario all|rain|clusters|boundary|churn|escape|crossfire] [--counts 1000,10000,...]
+//                          [--frames n] [--seed n] [--max-bruteforce n] [--kernel scalar|sse2|avx2] [--threads n]
+//                          [--leaf-capacity n] [--walls n] [--unindexed-walls] [--crates] [--solid] [--swept] [--rays n] [--csv] [--stats-dir path] [--trace-dir path]
+//                          [--record-dir path]
+
+#include "CollisionManager.h"
+#include "BroadphaseBackend.h"
+#include "CollisionProfiler.h"
+#include "CollisionReplay.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+//allocation counting, every heap allocation of the process goes through here.
+//the deletes stay out of line, gcc would otherwise see free() called on a pointer from operator new
+#if defined(_MSC_VER)
+#define BENCHMARK_NOINLINE __declspec(noinline)
+#else
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#endif
+
+static std::atomic<long long> s_allocationCount{ 0 };
+static std::atomic<long long> s_allocatedBytes{ 0 };
+
+void* operator new(std::size_t size)
+{
+	s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	s_allocatedBytes.fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+
+	if (void* p = std::malloc(size == 0 ? 1 : size))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+BENCHMARK_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+BENCHMARK_NOINLINE void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+BENCHMARK_NOINLINE void operator delete[](void* p) noexcept { std::free(p); }
+BENCHMARK_NOINLINE void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace
+{
+	const sf::Vector2u WORLD_SIZE(1280, 720);
+	const float BULLET_RADIUS = 10.f;
+	const float FRAME_TIME = 1.f / 60.f;
+
+	enum class EScenario
+	{
+		UniformRain,
+		DenseClusters,
+		BoundaryStreaming,
+		SpawnDespawn,
+		Escape,
+		Crossfire
+	};
+
+	const char* GetScenarioName(EScenario scenario)
+	{
+		switch (scenario)
+		{
+		case EScenario::UniformRain: return "rain";
+		case EScenario::DenseClusters: return "clusters";
+		case EScenario::BoundaryStreaming: return "boundary";
+		case EScenario::SpawnDespawn: return "churn";
+		case EScenario::Escape: return "escape";
+		case EScenario::Crossfire: return "crossfire";
+		}
+		return "";
+	}
+
+	enum class ECalculationMode
+	{
+		QuadTree,
+		QuadTreeLoose,
+		LinearQuadTree,
+		HashGrid,
+		SweepAndPrune,
+		BruteForce
+	};
+
+	const char* GetCalculationModeName(ECalculationMode mode)
+	{
+		switch (mode)
+		{
+		case ECalculationMode::QuadTree: return "quadtree";
+		case ECalculationMode::QuadTreeLoose: return "qt-loose";
+		case ECalculationMode::LinearQuadTree: return "linear";
+		case ECalculationMode::HashGrid: return "hashgrid";
+		case ECalculationMode::SweepAndPrune: return "sap";
+		case ECalculationMode::BruteForce: return "bruteforce";
+		}
+		return "";
+	}
+
+	struct BenchmarkOptions
+	{
+		std::vector<EScenario> scenarios = { EScenario::UniformRain, EScenario::DenseClusters, EScenario::BoundaryStreaming, EScenario::SpawnDespawn, EScenario::Escape, EScenario::Crossfire };
+		std::vector<int> counts = { 1000, 10000, 50000, 200000 };
+		int frames = 60;
+		unsigned int seed = 1337;
+		int maxBruteForceCount = 20000;
+		int threads = 1; //detection threads of the pointer QuadTree modes
+		int leafCapacity = QuadTreeConfig().leafCapacity;
+		int walls = 0;
+		bool unindexedWalls = false;
+		bool crates = false; //every other bullet is a box of the same size, exercises the box narrowphase
+		bool solid = false; //every other pair of bullets is solid, pairs of two solid ones are pushed apart while the tree is live
+		bool swept = false; //circle bullets are swept, exercises the continuous test
+		int rays = 0; //hitscan rays cast per frame through RaycastBatch
+		bool csv = false;
+		std::string statsDir; //per run CollisionFrameStats as <scenario>_<count>_<mode>.csv
+		std::string traceDir; //per run Chrome trace of the last frame as <scenario>_<count>_<mode>.json, needs COLLISION_PROFILING
+		std::string recordDir; //per scenario and count the workload as <scenario>_<count>.replay, see CollisionReplayDriver
+	};
+
+	struct Bullet
+	{
+		int id = 0;
+		sf::Vector2f position;
+		sf::Vector2f velocity;
+		float phase = 0.f;
+	};
+
+	struct PhaseTimer
+	{
+		double milliseconds = 0.0;
+		long long allocations = 0;
+
+		template<typename TFunc>
+		void Measure(TFunc&& func)
+		{
+			const long long allocationsBefore = s_allocationCount.load(std::memory_order_relaxed);
+			const auto start = std::chrono::steady_clock::now();
+
+			func();
+
+			const auto end = std::chrono::steady_clock::now();
+			milliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+			allocations += s_allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+		}
+	};
+
+	struct BenchmarkResult
+	{
+		PhaseTimer registerPhase;
+		PhaseTimer movePhase;
+		PhaseTimer updatePhase;
+		PhaseTimer churnPhase;
+		PhaseTimer raycastPhase;
+		PhaseTimer unregisterPhase;
+		long long pairTests = 0;
+		long long overlaps = 0;
+		int peakNodes = 0;
+	};
+
+	//deterministic scenario driver, identical input for both calculation modes
+	class ScenarioDriver
+	{
+	public:
+		ScenarioDriver(EScenario scenario, int count, unsigned int seed)
+			: m_scenario(scenario), m_count(count), m_rng(seed)
+		{
+		}
+
+		Bullet Spawn()
+		{
+			const float halfWidth = 0.5f * WORLD_SIZE.x;
+			const float halfHeight = 0.5f * WORLD_SIZE.y;
+
+			std::uniform_real_distribution<float> x(-halfWidth, halfWidth);
+			std::uniform_real_distribution<float> y(-halfHeight, halfHeight);
+			std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+			Bullet bullet;
+			switch (m_scenario)
+			{
+			case EScenario::UniformRain:
+			case EScenario::SpawnDespawn:
+				bullet.position = sf::Vector2f(x(m_rng), y(m_rng));
+				bullet.velocity = sf::Vector2f(20.f * unit(m_rng), 300.f + 200.f * std::abs(unit(m_rng)));
+				break;
+
+			case EScenario::DenseClusters:
+			{
+				//8 fixed cluster centers, bullets jitter around them
+				const int cluster = static_cast<int>(m_rng() % 8);
+				const sf::Vector2f center(-0.75f * halfWidth + cluster % 4 * 0.5f * halfWidth, cluster < 4 ? -0.5f * halfHeight : 0.5f * halfHeight);
+				std::normal_distribution<float> spread(0.f, 30.f);
+				bullet.position = center + sf::Vector2f(spread(m_rng), spread(m_rng));
+				bullet.velocity = sf::Vector2f(40.f * unit(m_rng), 40.f * unit(m_rng));
+				break;
+			}
+
+			case EScenario::Escape:
+			{
+				//away from the center and out of the world for good, no wrap
+				bullet.position = sf::Vector2f(x(m_rng), y(m_rng));
+				const float length = std::max(1.f, std::sqrt(bullet.position.x * bullet.position.x + bullet.position.y * bullet.position.y));
+				bullet.velocity = bullet.position * ((300.f + 600.f * std::abs(unit(m_rng))) / length);
+				break;
+			}
+
+			case EScenario::Crossfire:
+			{
+				//half of them cross several cells per frame, the rest drift. with --swept --crates every mode has to report
+				//the overlaps the brute force run finds, also those of a fast bullet with a crate in another leaf
+				bullet.position = sf::Vector2f(x(m_rng), y(m_rng));
+				const bool isFast = m_rng() % 2 == 0;
+				bullet.velocity = isFast ? sf::Vector2f((unit(m_rng) < 0.f ? -1.f : 1.f) * 3000.f, 100.f * unit(m_rng)) : sf::Vector2f(20.f * unit(m_rng), 20.f * unit(m_rng));
+				break;
+			}
+
+			case EScenario::BoundaryStreaming:
+				//oscillate across the root split lines every frame
+				bullet.position = sf::Vector2f(x(m_rng), y(m_rng));
+				bullet.velocity = sf::Vector2f(2.f * BULLET_RADIUS / FRAME_TIME, 2.f * BULLET_RADIUS / FRAME_TIME);
+				bullet.phase = (m_rng() % 2) ? 1.f : -1.f;
+				if (m_rng() % 2) bullet.position.x = 0.f;
+				else bullet.position.y = 0.f;
+				break;
+			}
+
+			return bullet;
+		}
+
+		//true if the bullet wrapped around the world
+		bool Move(Bullet& bullet)
+		{
+			const float halfWidth = 0.5f * WORLD_SIZE.x;
+			const float halfHeight = 0.5f * WORLD_SIZE.y;
+
+			if (m_scenario == EScenario::BoundaryStreaming)
+			{
+				bullet.phase = -bullet.phase;
+				bullet.position = bullet.position + bullet.velocity * (bullet.phase * FRAME_TIME);
+				return false;
+			}
+
+			if (m_scenario == EScenario::Escape)
+			{
+				bullet.position = bullet.position + bullet.velocity * FRAME_TIME;
+				return false;
+			}
+
+			const sf::Vector2f unwrapped = bullet.position + bullet.velocity * FRAME_TIME;
+			bullet.position = unwrapped;
+			if (bullet.position.y > halfHeight) bullet.position.y -= WORLD_SIZE.y;
+			if (bullet.position.x > halfWidth) bullet.position.x -= WORLD_SIZE.x;
+			if (bullet.position.x < -halfWidth) bullet.position.x += WORLD_SIZE.x;
+			if (bullet.position.y < -halfHeight) bullet.position.y += WORLD_SIZE.y;
+			return bullet.position != unwrapped;
+		}
+
+		int GetChurnPerFrame() const
+		{
+			return m_scenario == EScenario::SpawnDespawn ? std::max(1, m_count / 10) : 0;
+		}
+
+		std::mt19937& GetRng() { return m_rng; }
+
+	private:
+		EScenario m_scenario;
+		int m_count;
+		std::mt19937 m_rng;
+	};
+
+	BenchmarkResult RunBenchmark(EScenario scenario, int count, ECalculationMode mode, const BenchmarkOptions& options)
+	{
+		BenchmarkResult result;
+
+		CollisionManager collisionManager;
+		collisionManager.Init(WORLD_SIZE);
+		if (mode == ECalculationMode::BruteForce)
+			collisionManager.ToggleQTCalculation();
+		if (mode == ECalculationMode::QuadTree)
+			collisionManager.SetQTBoundsMode(EQuadTreeBoundsMode::Strict);
+		if (mode == ECalculationMode::LinearQuadTree)
+			collisionManager.SetBroadphaseBackend(EBroadphaseBackend::LinearQuadTree);
+		if (mode == ECalculationMode::HashGrid)
+			collisionManager.SetBroadphaseBackend(EBroadphaseBackend::HashGrid);
+		if (mode == ECalculationMode::SweepAndPrune)
+			collisionManager.SetBroadphaseBackend(EBroadphaseBackend::SweepAndPrune);
+		collisionManager.SetWorkerThreadCount(options.threads);
+		if (!options.statsDir.empty())
+			collisionManager.SetStatsRecorder(std::make_unique<CollisionStatsRecorder>(options.frames));
+
+		QuadTreeConfig config = collisionManager.GetQuadTreeConfig();
+		config.leafCapacity = options.leafCapacity;
+		config.mergeCapacity = std::min(config.mergeCapacity, config.leafCapacity - 1);
+		collisionManager.SetQuadTreeConfig(config);
+
+		//every mode feeds the same calls, one capture per workload
+		if (!options.recordDir.empty() && mode == ECalculationMode::QuadTree)
+		{
+			const std::string path = options.recordDir + "/" + GetScenarioName(scenario) + "_" + std::to_string(count) + ".replay";
+			auto recorder = std::make_unique<CollisionReplayRecorder>(path.c_str());
+			if (recorder->IsGood())
+				collisionManager.SetReplayRecorder(std::move(recorder));
+			else
+				std::fprintf(stderr, "could not write %s\n", path.c_str());
+		}
+
+		ScenarioDriver driver(scenario, count, options.seed);
+		long long overlaps = 0;
+		const TCollisionCallbackSignature callback = [&overlaps](const CollisionEntry&, const CollisionEntry&, sf::Vector2f) { overlaps++; };
+
+		CollisionShape bulletShape;
+		bulletShape.type = EShapeType::Circle;
+		bulletShape.radius = BULLET_RADIUS;
+
+		CollisionShape crateShape;
+		crateShape.type = EShapeType::Box;
+		crateShape.width = 2.f * BULLET_RADIUS;
+		crateShape.height = 2.f * BULLET_RADIUS;
+
+		auto getShape = [&](size_t bulletIndex) -> const CollisionShape& { return options.crates && bulletIndex % 2 == 1 ? crateShape : bulletShape; };
+		auto isTrigger = [&](size_t bulletIndex) { return !options.solid || bulletIndex / 2 % 2 == 1; };
+
+		std::vector<Bullet> bullets;
+		bullets.reserve(count);
+
+		result.registerPhase.Measure([&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				Bullet bullet = driver.Spawn();
+				bullet.id = collisionManager.RegisterShape(nullptr, getShape(bullets.size()), bullet.position, false, isTrigger(bullets.size()), callback);
+				if (options.swept)
+					collisionManager.SetShapeSwept(bullet.id, true);
+				bullets.push_back(bullet);
+			}
+		});
+
+		//static boxes spread over the world, in the static index unless --unindexed-walls
+		std::mt19937 wallRng(options.seed + 1);
+		std::uniform_real_distribution<float> wallX(-0.5f * WORLD_SIZE.x, 0.5f * WORLD_SIZE.x);
+		std::uniform_real_distribution<float> wallY(-0.5f * WORLD_SIZE.y, 0.5f * WORLD_SIZE.y);
+		for (int i = 0; i < options.walls; i++)
+		{
+			CollisionShape wallShape;
+			wallShape.type = EShapeType::Box;
+			wallShape.width = i % 2 == 0 ? 96.f : 16.f;
+			wallShape.height = i % 2 == 0 ? 16.f : 96.f;
+
+			collisionManager.RegisterShape(nullptr, wallShape, sf::Vector2f(wallX(wallRng), wallY(wallRng)), true, true, callback,
+				options.unindexedWalls ? ECollisionIndexPolicy::Unindexed : ECollisionIndexPolicy::Auto);
+		}
+		collisionManager.RebuildStaticIndex();
+		collisionManager.ResetPairTestCount();
+
+		//fresh rays every frame from the same stream, so every mode casts the same ones
+		std::mt19937 rayRng(options.seed + 2);
+		std::vector<CollisionRay> rays(options.rays);
+		std::vector<CollisionRayHit> rayHits(options.rays);
+
+		const bool isTracing = !options.traceDir.empty();
+
+		for (int frame = 0; frame < options.frames; frame++)
+		{
+			if (isTracing && frame == options.frames - 1)
+				CollisionProfiler::GetInstance().BeginCapture();
+
+			result.movePhase.Measure([&]()
+			{
+				for (Bullet& bullet : bullets)
+				{
+					const bool isWrapped = driver.Move(bullet);
+					collisionManager.UpdateShapePosition(bullet.id, bullet.position);
+					//a wrap is a teleport, not a path across the world
+					if (options.swept && isWrapped)
+						collisionManager.SetShapeSwept(bullet.id, true);
+				}
+			});
+
+			result.updatePhase.Measure([&]()
+			{
+				collisionManager.Update(FRAME_TIME);
+			});
+
+			for (CollisionRay& ray : rays)
+			{
+				ray.origin = sf::Vector2f(wallX(rayRng), wallY(rayRng));
+				ray.end = sf::Vector2f(wallX(rayRng), wallY(rayRng));
+			}
+
+			result.raycastPhase.Measure([&]()
+			{
+				collisionManager.RaycastBatch(rays.data(), options.rays, rayHits.data());
+			});
+
+			result.churnPhase.Measure([&]()
+			{
+				for (int i = 0; i < driver.GetChurnPerFrame(); i++)
+				{
+					Bullet& bullet = bullets[driver.GetRng()() % bullets.size()];
+					collisionManager.UnregisterShape(bullet.id);
+
+					const Bullet spawned = driver.Spawn();
+					bullet.position = spawned.position;
+					bullet.velocity = spawned.velocity;
+					bullet.id = collisionManager.RegisterShape(nullptr, getShape(&bullet - bullets.data()), bullet.position, false, isTrigger(&bullet - bullets.data()), callback);
+					if (options.swept)
+						collisionManager.SetShapeSwept(bullet.id, true);
+					collisionManager.UpdateShapePosition(bullet.id, bullet.position);
+				}
+			});
+		}
+
+		if (isTracing)
+		{
+			CollisionProfiler& profiler = CollisionProfiler::GetInstance();
+			profiler.EndCapture();
+
+			const std::string path = options.traceDir + "/" + GetScenarioName(scenario) + "_" + std::to_string(count) + "_" + GetCalculationModeName(mode) + ".json";
+			if (!profiler.WriteChromeTrace(path.c_str()))
+				std::fprintf(stderr, "could not write %s\n", path.c_str());
+			if (profiler.GetDroppedEventCount() > 0)
+				std::fprintf(stderr, "%s: %lld trace events dropped\n", path.c_str(), profiler.GetDroppedEventCount());
+		}
+
+		result.pairTests = collisionManager.GetPairTestCount();
+		if (!options.statsDir.empty())
+		{
+			const std::string path = options.statsDir + "/" + GetScenarioName(scenario) + "_" + std::to_string(count) + "_" + GetCalculationModeName(mode) + ".csv";
+			if (!collisionManager.GetStatsRecorder()->WriteCsv(path.c_str()))
+				std::fprintf(stderr, "could not write %s\n", path.c_str());
+		}
+		result.overlaps = overlaps / 2; //the callback fires for both sides of a pair
+		if (const BroadphaseBackend* broadphase = collisionManager.GetRebuiltBroadphase())
+			result.peakNodes = broadphase->GetNodeCount(); //of the last rebuild
+		else
+			result.peakNodes = collisionManager.GetQuadTree()->GetPeakNodeCount();
+
+		result.unregisterPhase.Measure([&]()
+		{
+			for (const Bullet& bullet : bullets)
+			{
+				collisionManager.UnregisterShape(bullet.id);
+			}
+		});
+
+		return result;
+	}
+
+	void PrintHeader(const BenchmarkOptions& options)
+	{
+		if (options.csv)
+		{
+			std::printf("scenario,count,mode,register_ms,move_ms_per_frame,update_ms_per_frame,churn_ms_per_frame,unregister_ms,"
+				"raycast_ms_per_frame,pair_tests_per_frame,overlaps_per_frame,allocs_per_frame,peak_nodes\n");
+		}
+		else
+		{
+			std::printf("%-9s %7s %-10s %10s %10s %10s %10s %10s %10s %14s %12s %10s %8s\n",
+				"scenario", "count", "mode", "register", "move/f", "update/f", "churn/f", "unregister", "rays/f",
+				"pairtests/f", "overlaps/f", "allocs/f", "nodes");
+		}
+	}
+
+	void PrintResult(EScenario scenario, int count, ECalculationMode calculationMode, const BenchmarkResult& result, const BenchmarkOptions& options)
+	{
+		const char* mode = GetCalculationModeName(calculationMode);
+		const double frames = std::max(1, options.frames);
+		const double allocationsPerFrame = (result.movePhase.allocations + result.updatePhase.allocations + result.churnPhase.allocations + result.raycastPhase.allocations) / frames;
+
+		if (options.csv)
+		{
+			std::printf("%s,%d,%s,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f,%d\n",
+				GetScenarioName(scenario), count, mode,
+				result.registerPhase.milliseconds, result.movePhase.milliseconds / frames, result.updatePhase.milliseconds / frames,
+				result.churnPhase.milliseconds / frames, result.unregisterPhase.milliseconds, result.raycastPhase.milliseconds / frames,
+				result.pairTests / frames, result.overlaps / frames, allocationsPerFrame, result.peakNodes);
+		}
+		else
+		{
+			std::printf("%-9s %7d %-10s %8.2fms %8.3fms %8.3fms %8.3fms %8.2fms %8.3fms %14.0f %12.0f %10.1f %8d\n",
+				GetScenarioName(scenario), count, mode,
+				result.registerPhase.milliseconds, result.movePhase.milliseconds / frames, result.updatePhase.milliseconds / frames,
+				result.churnPhase.milliseconds / frames, result.unregisterPhase.milliseconds, result.raycastPhase.milliseconds / frames,
+				result.pairTests / frames, result.overlaps / frames, allocationsPerFrame, result.peakNodes);
+		}
+	}
+
+	std::vector<int> ParseCounts(const char* text)
+	{
+		std::vector<int> counts;
+		std::string list(text);
+		size_t start = 0;
+		while (start < list.size())
+		{
+			size_t end = list.find(',', start);
+			if (end == std::string::npos) end = list.size();
+			counts.push_back(std::atoi(list.substr(start, end - start).c_str()));
+			start = end + 1;
+		}
+		return counts;
+	}
+
+	bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const bool hasValue = i + 1 < argc;
+
+			if (std::strcmp(argv[i], "--scenario") == 0 && hasValue)
+			{
+				const std::string name = argv[++i];
+				if (name == "all") continue;
+
+				options.scenarios.clear();
+				for (EScenario scenario : { EScenario::UniformRain, EScenario::DenseClusters, EScenario::BoundaryStreaming, EScenario::SpawnDespawn, EScenario::Escape, EScenario::Crossfire })
+				{
+					if (name == GetScenarioName(scenario))
+						options.scenarios.push_back(scenario);
+				}
+				if (options.scenarios.empty())
+					return false;
+			}
+			else if (std::strcmp(argv[i], "--counts") == 0 && hasValue) options.counts = ParseCounts(argv[++i]);
+			else if (std::strcmp(argv[i], "--frames") == 0 && hasValue) options.frames = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--max-bruteforce") == 0 && hasValue) options.maxBruteForceCount = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--kernel") == 0 && hasValue)
+			{
+				const std::string name = argv[++i];
+				bool found = false;
+				for (ECollisionKernelImplementation implementation : { ECollisionKernelImplementation::Scalar, ECollisionKernelImplementation::SSE2, ECollisionKernelImplementation::AVX2 })
+				{
+					if (name == CollisionKernels::GetImplementationName(implementation) && CollisionKernels::IsSupported(implementation))
+					{
+						CollisionKernels::SetImplementation(implementation);
+						found = true;
+					}
+				}
+				if (!found)
+					return false;
+			}
+			else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) options.threads = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--leaf-capacity") == 0 && hasValue)
+			{
+				options.leafCapacity = std::atoi(argv[++i]);
+				if (options.leafCapacity < 1 || options.leafCapacity >= QUADTREE_QUARTER_SLOTS)
+					return false;
+			}
+			else if (std::strcmp(argv[i], "--walls") == 0 && hasValue) options.walls = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--unindexed-walls") == 0) options.unindexedWalls = true;
+			else if (std::strcmp(argv[i], "--crates") == 0) options.crates = true;
+			else if (std::strcmp(argv[i], "--solid") == 0) options.solid = true;
+			else if (std::strcmp(argv[i], "--swept") == 0) options.swept = true;
+			else if (std::strcmp(argv[i], "--rays") == 0 && hasValue) options.rays = std::max(0, std::atoi(argv[++i]));
+			else if (std::strcmp(argv[i], "--csv") == 0) options.csv = true;
+			else if (std::strcmp(argv[i], "--stats-dir") == 0 && hasValue) options.statsDir = argv[++i];
+			else if (std::strcmp(argv[i], "--trace-dir") == 0 && hasValue) options.traceDir = argv[++i];
+			else if (std::strcmp(argv[i], "--record-dir") == 0 && hasValue) options.recordDir = argv[++i];
+			else return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		std::printf("usage: %s [--scenario all|rain|clusters|boundary|churn|escape|crossfire] [--counts 1000,10000,...] [--frames n] [--seed n] [--max-bruteforce n] [--kernel scalar|sse2|avx2] [--threads n] [--leaf-capacity n] [--walls n] [--unindexed-walls] [--crates] [--solid] [--swept] [--rays n] [--csv] [--stats-dir path] [--trace-dir path] [--record-dir path]\n", argv[0]);
+		return 1;
+	}
+
+	if (!options.csv)
+		std::printf("narrowphase kernel: %s, detection threads: %d\n", CollisionKernels::GetImplementationName(CollisionKernels::GetImplementation()), options.threads);
+
+#ifndef COLLISION_PROFILING
+	if (!options.traceDir.empty())
+		std::fprintf(stderr, "--trace-dir: built without COLLISION_PROFILING, the traces stay empty\n");
+#endif
+
+	//a traced frame moves every bullet, one UpdateShapePosition zone each
+	const int maxCount = *std::max_element(options.counts.begin(), options.counts.end());
+	CollisionProfiler::GetInstance().SetThreadCapacity(2 * maxCount + (1 << 16));
+
+	PrintHeader(options);
+
+	for (EScenario scenario : options.scenarios)
+	{
+		for (int count : options.counts)
+		{
+			for (ECalculationMode mode : { ECalculationMode::QuadTree, ECalculationMode::QuadTreeLoose, ECalculationMode::LinearQuadTree, ECalculationMode::HashGrid, ECalculationMode::SweepAndPrune, ECalculationMode::BruteForce })
+			{
+				//O(N^2), only run it where it finishes in reasonable time
+				if (mode == ECalculationMode::BruteForce && count > options.maxBruteForceCount)
+					continue;
+
+				PrintResult(scenario, count, mode, RunBenchmark(scenario, count, mode, options), options);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,234 @@
+//Headless playback of a recorded collision workload (see CollisionReplay.h) against every broadphase, at full speed.
+//A capture comes from CollisionManager::SetReplayRecorder in the game or from CollisionBenchmark --record-dir. Build like the benchmark:
+//	g++ -std=c++17 -O2 -I.. -I<engine source root> -I<sfml>/include CollisionReplayDriver.cpp ../CollisionManager.cpp ../CollisionKernels.cpp ../LinearQuadTree.cpp ../SpatialHashGrid.cpp ../SweepAndPrune.cpp ../CollisionJobSystem.cpp ../StaticCollisionIndex.cpp ../CollisionStats.cpp ../CollisionProfiler.cpp ../CollisionReplay.cpp -pthread -o CollisionReplayDriver
+//
+//usage: CollisionReplayDriver <file.replay> [--mode all|quadtree|qt-loose|linear|hashgrid|sap|bruteforce] [--repeat n]
+//                             [--kernel scalar|sse2|avx2] [--threads n] [--csv]
+
+#include "CollisionManager.h"
+#include "CollisionReplay.h"
+#include "BroadphaseBackend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	enum class EReplayMode
+	{
+		QuadTree,
+		QuadTreeLoose,
+		LinearQuadTree,
+		HashGrid,
+		SweepAndPrune,
+		BruteForce
+	};
+
+	const EReplayMode ALL_MODES[] = { EReplayMode::QuadTree, EReplayMode::QuadTreeLoose, EReplayMode::LinearQuadTree, EReplayMode::HashGrid,
+		EReplayMode::SweepAndPrune, EReplayMode::BruteForce };
+
+	const char* GetModeName(EReplayMode mode)
+	{
+		switch (mode)
+		{
+		case EReplayMode::QuadTree: return "quadtree";
+		case EReplayMode::QuadTreeLoose: return "qt-loose";
+		case EReplayMode::LinearQuadTree: return "linear";
+		case EReplayMode::HashGrid: return "hashgrid";
+		case EReplayMode::SweepAndPrune: return "sap";
+		case EReplayMode::BruteForce: return "bruteforce";
+		}
+		return "";
+	}
+
+	struct ReplayOptions
+	{
+		const char* path = nullptr;
+		std::vector<EReplayMode> modes = { EReplayMode::QuadTree, EReplayMode::QuadTreeLoose, EReplayMode::LinearQuadTree, EReplayMode::HashGrid, EReplayMode::SweepAndPrune };
+		int repeat = 1; //playbacks per mode, the fastest one is reported
+		int threads = 1;
+		bool csv = false;
+	};
+
+	struct ReplayResult
+	{
+		long long frames = 0;
+		double totalMilliseconds = 0.0;
+		double worstMilliseconds = 0.0; //the hitch: slowest frame and its index
+		long long worstFrame = 0;
+		long long pairTests = 0;
+		long long overlaps = 0;
+		int nodes = 0;
+		bool isCorrupt = false;
+	};
+
+	//one frame is its recorded moves, registrations and removals plus the Update
+	ReplayResult Play(CollisionReplayPlayer& player, EReplayMode mode, const ReplayOptions& options)
+	{
+		ReplayResult result;
+
+		CollisionManager collisionManager;
+		collisionManager.Init(player.GetConfig());
+		if (mode == EReplayMode::BruteForce)
+			collisionManager.ToggleQTCalculation();
+		if (mode == EReplayMode::QuadTree)
+			collisionManager.SetQTBoundsMode(EQuadTreeBoundsMode::Strict);
+		if (mode == EReplayMode::LinearQuadTree)
+			collisionManager.SetBroadphaseBackend(EBroadphaseBackend::LinearQuadTree);
+		if (mode == EReplayMode::HashGrid)
+			collisionManager.SetBroadphaseBackend(EBroadphaseBackend::HashGrid);
+		if (mode == EReplayMode::SweepAndPrune)
+			collisionManager.SetBroadphaseBackend(EBroadphaseBackend::SweepAndPrune);
+		collisionManager.SetWorkerThreadCount(options.threads);
+
+		player.Rewind();
+		while (true)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			const bool isFrame = player.PlayFrame(collisionManager);
+			const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (!isFrame)
+				break;
+
+			result.frames++;
+			result.totalMilliseconds += milliseconds;
+			if (milliseconds > result.worstMilliseconds)
+			{
+				result.worstMilliseconds = milliseconds;
+				result.worstFrame = player.GetFrameIndex() - 1;
+			}
+			result.overlaps += collisionManager.GetFrameStats().overlaps;
+		}
+
+		result.isCorrupt = player.IsCorrupt();
+		result.pairTests = collisionManager.GetPairTestCount();
+		if (const BroadphaseBackend* broadphase = collisionManager.GetRebuiltBroadphase())
+			result.nodes = broadphase->GetNodeCount();
+		else
+			result.nodes = collisionManager.GetQuadTree()->GetPeakNodeCount();
+
+		return result;
+	}
+
+	void PrintHeader(const ReplayOptions& options)
+	{
+		if (options.csv)
+			std::printf("mode,frames,frame_ms,worst_frame_ms,worst_frame,pair_tests_per_frame,overlaps_per_frame,nodes\n");
+		else
+			std::printf("%-10s %8s %10s %10s %8s %14s %12s %8s\n", "mode", "frames", "frame", "worst", "at", "pairtests/f", "overlaps/f", "nodes");
+	}
+
+	void PrintResult(EReplayMode mode, const ReplayResult& result, const ReplayOptions& options)
+	{
+		const double frames = static_cast<double>(std::max(1LL, result.frames));
+
+		if (options.csv)
+		{
+			std::printf("%s,%lld,%.3f,%.3f,%lld,%.1f,%.1f,%d\n", GetModeName(mode), result.frames, result.totalMilliseconds / frames,
+				result.worstMilliseconds, result.worstFrame, result.pairTests / frames, result.overlaps / frames, result.nodes);
+		}
+		else
+		{
+			std::printf("%-10s %8lld %8.3fms %8.3fms %8lld %14.0f %12.0f %8d\n", GetModeName(mode), result.frames, result.totalMilliseconds / frames,
+				result.worstMilliseconds, result.worstFrame, result.pairTests / frames, result.overlaps / frames, result.nodes);
+		}
+	}
+
+	bool ParseOptions(int argc, char** argv, ReplayOptions& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const bool hasValue = i + 1 < argc;
+
+			if (std::strcmp(argv[i], "--mode") == 0 && hasValue)
+			{
+				const std::string name = argv[++i];
+				options.modes.clear();
+				for (EReplayMode mode : ALL_MODES)
+				{
+					if (name == "all" || name == GetModeName(mode))
+						options.modes.push_back(mode);
+				}
+				if (options.modes.empty())
+					return false;
+			}
+			else if (std::strcmp(argv[i], "--repeat") == 0 && hasValue) options.repeat = std::max(1, std::atoi(argv[++i]));
+			else if (std::strcmp(argv[i], "--kernel") == 0 && hasValue)
+			{
+				const std::string name = argv[++i];
+				bool found = false;
+				for (ECollisionKernelImplementation implementation : { ECollisionKernelImplementation::Scalar, ECollisionKernelImplementation::SSE2, ECollisionKernelImplementation::AVX2 })
+				{
+					if (name == CollisionKernels::GetImplementationName(implementation) && CollisionKernels::IsSupported(implementation))
+					{
+						CollisionKernels::SetImplementation(implementation);
+						found = true;
+					}
+				}
+				if (!found)
+					return false;
+			}
+			else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) options.threads = std::atoi(argv[++i]);
+			else if (std::strcmp(argv[i], "--csv") == 0) options.csv = true;
+			else if (argv[i][0] != '-' && options.path == nullptr) options.path = argv[i];
+			else return false;
+		}
+
+		return options.path != nullptr;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ReplayOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		std::printf("usage: %s <file.replay> [--mode all|quadtree|qt-loose|linear|hashgrid|sap|bruteforce] [--repeat n] [--kernel scalar|sse2|avx2] [--threads n] [--csv]\n", argv[0]);
+		return 1;
+	}
+
+	CollisionReplayFile file;
+	if (!file.Open(options.path))
+	{
+		std::fprintf(stderr, "could not map %s\n", options.path);
+		return 1;
+	}
+
+	CollisionReplayPlayer player(file.GetData(), file.GetSize());
+	if (!player.IsValid())
+	{
+		std::fprintf(stderr, "%s is not a replay of this format version\n", options.path);
+		return 1;
+	}
+
+	if (!options.csv)
+		std::printf("%s: %zu bytes, narrowphase kernel: %s, detection threads: %d\n", options.path, file.GetSize(),
+			CollisionKernels::GetImplementationName(CollisionKernels::GetImplementation()), options.threads);
+
+	PrintHeader(options);
+
+	bool isCorrupt = false;
+	for (EReplayMode mode : options.modes)
+	{
+		ReplayResult best;
+		for (int run = 0; run < options.repeat; run++)
+		{
+			const ReplayResult result = Play(player, mode, options);
+			if (run == 0 || result.totalMilliseconds < best.totalMilliseconds)
+				best = result;
+		}
+
+		isCorrupt |= best.isCorrupt;
+		PrintResult(mode, best, options);
+	}
+
+	if (isCorrupt)
+		std::fprintf(stderr, "%s: truncated or corrupt record after frame %lld\n", options.path, player.GetFrameIndex());
+
+	return isCorrupt ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "CollisionTypes.h"
+
+#include <vector>
+
+//Broadphase that is synced from the QuadTree shapes' SoA once per Update and hands out candidate pairs,
+//selected through EBroadphaseBackend next to the incrementally updated pointer QuadTree.
+//Pairs are overlaps of the bounding circles in the SoA, the CollisionManager shape tests them.
+class BroadphaseBackend
+{
+public:
+	virtual ~BroadphaseBackend() = default;
+
+	//entries flagged COLLISION_FLAG_DELETED are skipped
+	virtual void Build(const CollisionEntrySoA& shapes, const CollisionAABB& worldBounds) = 0;
+
+	//overlapping pairs by bounding circle, dense indices into the shapes passed to Build
+	virtual void GeneratePairs(std::vector<CollisionPair>& outPairs) = 0;
+
+	//nodes / cells of the last Build, for stats
+	virtual int GetNodeCount() const = 0;
+	virtual long long GetPairTestCount() const = 0;
+};
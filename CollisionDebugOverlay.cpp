@@ -0,0 +1,230 @@
+#include "CollisionDebugOverlay.h"
+
+#include "Engine/EntitySystem/EntitySystemDefinitions.h"
+
+#include <string>
+
+void CollisionManager::Init()
+{
+	const sf::Vector2u size = Engine::GetInstance()->GetRenderWindow().getSize();
+
+	Init(size);
+
+	SetOwnerMoveCallback([](Entity* pOwner, sf::Vector2f position) { pOwner->SetPosition(position); });
+
+	std::unique_ptr<CollisionDebugOverlay> overlay = std::make_unique<CollisionDebugOverlay>();
+	overlay->Init(this);
+	SetDebugLayer(std::move(overlay));
+}
+
+void CollisionDebugOverlay::Init(CollisionManager* manager)
+{
+	m_collisionManager = manager;
+
+	sf::Vector2u size = Engine::GetInstance()->GetRenderWindow().getSize();
+
+	//Input
+	m_calculationInputCallbackId = Engine::GetInstance()->GetInputManager().Register(sf::Keyboard::Q, EInputEvent::Released, std::bind(&CollisionDebugOverlay::OnQTCalculationInputPressed, this));
+	m_QTActiveTextEntity = Engine::GetInstance()->GetEntitySystem().SpawnEntity<Entity>();
+	m_QTActiveTextComponent = m_QTActiveTextEntity->AddComponent<TextRenderComponent>();
+	m_QTActiveTextComponent->SetFontByPath("../Assets/Fonts/Roboto-Light.ttf");
+	m_QTActiveTextComponent->GetText().setString("Press 'q': Activate Quadtree: " + std::to_string(m_collisionManager->IsUsingQTCalculation()));
+	m_QTActiveTextEntity->SetPosition(sf::Vector2f(-0.5f * size.x + 25, 0.5f * size.y - 80));
+
+	m_backendInputCallbackId = Engine::GetInstance()->GetInputManager().Register(sf::Keyboard::B, EInputEvent::Released, std::bind(&CollisionDebugOverlay::OnBackendInputPressed, this));
+	m_backendTextEntity = Engine::GetInstance()->GetEntitySystem().SpawnEntity<Entity>();
+	m_backendTextComponent = m_backendTextEntity->AddComponent<TextRenderComponent>();
+	m_backendTextComponent->SetFontByPath("../Assets/Fonts/Roboto-Light.ttf");
+	m_backendTextComponent->GetText().setString(std::string("Press 'b': Broadphase: ") + GetBackendName(m_collisionManager->GetBroadphaseBackend()));
+	m_backendTextEntity->SetPosition(sf::Vector2f(-0.5f * size.x + 25, 0.5f * size.y - 110));
+
+	m_visualizationInputCallbackId = Engine::GetInstance()->GetInputManager().Register(sf::Keyboard::V, EInputEvent::Released, std::bind(&CollisionDebugOverlay::OnQTVisualizationInputPressed, this));
+	m_QTVisibilityTextEntity = Engine::GetInstance()->GetEntitySystem().SpawnEntity<Entity>();
+	m_QTVisibilityTextComponent = m_QTVisibilityTextEntity->AddComponent<TextRenderComponent>();
+	m_QTVisibilityTextComponent->SetFontByPath("../Assets/Fonts/Roboto-Light.ttf");
+	m_QTVisibilityTextComponent->GetText().setString("Press 'v': Quadtree-Visualization: " + std::to_string(m_showQT));
+	m_QTVisibilityTextEntity->SetPosition(sf::Vector2f(-0.5f * size.x + 25, 0.5f * size.y - 50));
+
+	m_BulletCountTextEntity = Engine::GetInstance()->GetEntitySystem().SpawnEntity<Entity>();
+	m_BulletCountTextComponent = m_BulletCountTextEntity->AddComponent<TextRenderComponent>();
+	m_BulletCountTextComponent->SetFontByPath("../Assets/Fonts/Roboto-Light.ttf");
+	m_BulletCountTextComponent->GetText().setString("Bullets: " + std::to_string(m_collisionManager->GetBulletCount()));
+	m_BulletCountTextEntity->SetPosition(sf::Vector2f(-0.5f * size.x + 25, -0.5f * size.y + 50));
+}
+
+CollisionDebugOverlay::~CollisionDebugOverlay()
+{
+	DetachFromQuadTree();
+
+	Engine::GetInstance()->GetInputManager().Unregister(m_calculationInputCallbackId);
+	Engine::GetInstance()->GetInputManager().Unregister(m_backendInputCallbackId);
+	Engine::GetInstance()->GetInputManager().Unregister(m_visualizationInputCallbackId);
+}
+
+void CollisionDebugOverlay::OnQTCalculationInputPressed()
+{
+	m_collisionManager->ToggleQTCalculation();
+	m_QTActiveTextComponent->GetText().setString("Press 'q': Activate Quadtree: " + std::to_string(m_collisionManager->IsUsingQTCalculation()));
+}
+
+void CollisionDebugOverlay::OnBackendInputPressed()
+{
+	//QuadTree -> LinearQuadTree -> HashGrid -> SweepAndPrune -> QuadTree
+	const EBroadphaseBackend backend = m_collisionManager->GetBroadphaseBackend();
+	const EBroadphaseBackend next = backend == EBroadphaseBackend::QuadTree ? EBroadphaseBackend::LinearQuadTree
+		: backend == EBroadphaseBackend::LinearQuadTree ? EBroadphaseBackend::HashGrid
+		: backend == EBroadphaseBackend::HashGrid ? EBroadphaseBackend::SweepAndPrune : EBroadphaseBackend::QuadTree;
+
+	m_collisionManager->SetBroadphaseBackend(next);
+	m_backendTextComponent->GetText().setString(std::string("Press 'b': Broadphase: ") + GetBackendName(next));
+}
+
+const char* CollisionDebugOverlay::GetBackendName(EBroadphaseBackend backend)
+{
+	switch (backend)
+	{
+	case EBroadphaseBackend::QuadTree: return "quadtree";
+	case EBroadphaseBackend::LinearQuadTree: return "linear quadtree";
+	case EBroadphaseBackend::HashGrid: return "hash grid";
+	case EBroadphaseBackend::SweepAndPrune: return "sweep and prune";
+	}
+	return "";
+}
+
+void CollisionDebugOverlay::OnQTVisualizationInputPressed()
+{
+	Engine::GetInstance()->GetRenderSystem().ToggleQuadtreeView();
+
+	m_showQT = !m_showQT;
+	m_QTVisibilityTextComponent->GetText().setString("Press 'v': Quadtree-Visualization: " + std::to_string(m_showQT));
+
+	if (m_showQT)
+		AttachToQuadTree();
+	else
+		DetachFromQuadTree();
+}
+
+void CollisionDebugOverlay::AttachToQuadTree()
+{
+	QuadTree* quadtree = m_collisionManager->GetQuadTree();
+	quadtree->SetObserver(this);
+
+	//catch up with the nodes that were created while detached
+	std::vector<int> nodes = { quadtree->GetRootIndex() };
+	while (!nodes.empty())
+	{
+		const int nodeIndex = nodes.back();
+		nodes.pop_back();
+		if (nodeIndex == -1)
+			continue;
+
+		const QuadTreeNode& node = quadtree->GetNode(nodeIndex);
+		OnQTNodeCreated(node);
+		for (int quarter = 0; quarter < 4; quarter++)
+		{
+			OnQTQuarterCountChanged(node, quarter);
+			nodes.push_back(node.m_children[quarter]);
+		}
+	}
+}
+
+void CollisionDebugOverlay::DetachFromQuadTree()
+{
+	if (QuadTree* quadtree = m_collisionManager->GetQuadTree())
+		quadtree->SetObserver(nullptr);
+
+	for (auto& [nodeIndex, visual] : m_nodeVisuals)
+	{
+		DestroyVisual(visual);
+	}
+	m_nodeVisuals.clear();
+}
+
+void CollisionDebugOverlay::OnQTNodeCreated(const QuadTreeNode& node)
+{
+	QTNodeVisual& visual = m_nodeVisuals[node.m_index];
+
+	const sf::Vector2f centerOffset = node.GetCenterOffset();
+	const sf::Vector2u size = node.GetSize();
+	int halfWidth = 0.5f * size.x;
+	int halfHeigt = 0.5f * size.y;
+	visual.renderIndexHorizontal = Engine::GetInstance()->GetRenderSystem().AddLine(sf::Vector2f(centerOffset.x - halfWidth, centerOffset.y), sf::Vector2f(centerOffset.x + halfWidth, centerOffset.y));
+	visual.renderIndexVertical = Engine::GetInstance()->GetRenderSystem().AddLine(sf::Vector2f(centerOffset.x, centerOffset.y - halfHeigt), sf::Vector2f(centerOffset.x, centerOffset.y + halfHeigt));
+
+	for (int quarter = 0; quarter < 4; quarter++)
+	{
+		Entity* pInputPrompt = Engine::GetInstance()->GetEntitySystem().SpawnEntity<Entity>();
+		visual.textEntities[quarter] = pInputPrompt;
+		visual.textCountComponents[quarter] = pInputPrompt->AddComponent<TextRenderComponent>();
+		visual.textCountComponents[quarter]->SetFontByPath("../Assets/Fonts/Roboto-Light.ttf", true);
+		visual.textCountComponents[quarter]->GetText().setString("0");
+		visual.textCountComponents[quarter]->CenterText();
+		visual.textCountComponents[quarter]->ClearText();
+
+		float x = 1;
+		float y = 1;
+		switch (quarter)
+		{
+		case 0:
+			x = -1;
+			y = -1;
+			break;
+		case 1:
+			y = -1;
+			break;
+		case 2:
+			break;
+		case 3:
+			x = -1;
+			break;
+		}
+
+		x *= 25.f;
+		y *= 25.f;
+
+		pInputPrompt->SetPosition(pInputPrompt->GetPosition() + sf::Vector2f(x, y) + centerOffset);
+	}
+}
+
+void CollisionDebugOverlay::OnQTNodeDestroyed(const QuadTreeNode& node)
+{
+	auto it = m_nodeVisuals.find(node.m_index);
+	if (it == m_nodeVisuals.end())
+		return;
+
+	DestroyVisual(it->second);
+	m_nodeVisuals.erase(it);
+}
+
+void CollisionDebugOverlay::DestroyVisual(QTNodeVisual& visual)
+{
+	Engine::GetInstance()->GetRenderSystem().RemoveLine(visual.renderIndexHorizontal);
+	Engine::GetInstance()->GetRenderSystem().RemoveLine(visual.renderIndexVertical);
+
+	for (int i = 0; i < 4; i++)
+	{
+		visual.textEntities[i]->Destroy();
+	}
+}
+
+void CollisionDebugOverlay::OnQTQuarterCountChanged(const QuadTreeNode& node, int quarter)
+{
+	auto it = m_nodeVisuals.find(node.m_index);
+	if (it == m_nodeVisuals.end())
+		return;
+
+	TextRenderComponent* textComponent = it->second.textCountComponents[quarter];
+	if (node.quaterEntryCount[quarter] == 0)
+	{
+		textComponent->ClearText();
+	}
+	else
+	{
+		textComponent->GetText().setString(std::to_string(node.quaterEntryCount[quarter]));
+	}
+}
+
+void CollisionDebugOverlay::OnBulletCountChanged(int bulletCount)
+{
+	m_BulletCountTextComponent->GetText().setString("Bullets: " + std::to_string(bulletCount));
+}
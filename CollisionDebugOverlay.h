@@ -0,0 +1,64 @@
+#pragma once
+
+#include "CollisionManager.h"
+
+#include "Engine/Engine.h"
+#include "Engine/Rendering/RenderSystem.h"
+#include "Engine/EntitySystem/EntitySystem.h"
+#include "Engine/EntitySystem/Components/TextRenderComponent.h"
+#include "Engine/Input/InputManager.h"
+
+#include <SFML/Graphics.hpp>
+#include <unordered_map>
+
+//engine-side debug layer for the CollisionManager:
+//'q' toggles the quadtree calculation, 'b' cycles the broadphase backend, 'v' toggles the quadtree visualization.
+//the per-node lines and count texts only exist while the visualization is on,
+//the overlay attaches itself to the QuadTree as observer at that point.
+class CollisionDebugOverlay : public ICollisionDebugLayer
+{
+public:
+	void Init(CollisionManager* manager);
+	~CollisionDebugOverlay();
+
+	void OnQTNodeCreated(const QuadTreeNode& node) override;
+	void OnQTNodeDestroyed(const QuadTreeNode& node) override;
+	void OnQTQuarterCountChanged(const QuadTreeNode& node, int quarter) override;
+	void OnBulletCountChanged(int bulletCount) override;
+
+	void OnQTCalculationInputPressed();
+	void OnBackendInputPressed();
+	void OnQTVisualizationInputPressed();
+
+private:
+
+	struct QTNodeVisual
+	{
+		int renderIndexHorizontal = 0;
+		int renderIndexVertical = 0;
+		Entity* textEntities[4] = {};
+		TextRenderComponent* textCountComponents[4] = {};
+	};
+
+	static const char* GetBackendName(EBroadphaseBackend backend);
+	void DestroyVisual(QTNodeVisual& visual);
+	void AttachToQuadTree();
+	void DetachFromQuadTree();
+
+	CollisionManager* m_collisionManager = nullptr;
+	std::unordered_map<int, QTNodeVisual> m_nodeVisuals;
+
+	int m_calculationInputCallbackId = 0;
+	int m_backendInputCallbackId = 0;
+	int m_visualizationInputCallbackId = 0;
+	bool m_showQT = false;
+
+	Entity* m_QTActiveTextEntity = nullptr;
+	TextRenderComponent* m_QTActiveTextComponent = nullptr;
+	Entity* m_backendTextEntity = nullptr;
+	TextRenderComponent* m_backendTextComponent = nullptr;
+	Entity* m_QTVisibilityTextEntity = nullptr;
+	TextRenderComponent* m_QTVisibilityTextComponent = nullptr;
+	Entity* m_BulletCountTextEntity = nullptr;
+	TextRenderComponent* m_BulletCountTextComponent = nullptr;
+};
@@ -0,0 +1,159 @@
+#include "CollisionJobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+
+CollisionJobSystem::~CollisionJobSystem()
+{
+	Stop();
+}
+
+void CollisionJobSystem::Start(int workerCount)
+{
+	Stop();
+
+	if (workerCount <= 0)
+		workerCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+	for (int i = 0; i < workerCount; i++)
+	{
+		m_queues.push_back(std::make_unique<WorkerQueue>());
+	}
+
+	m_isStopping = false;
+	for (int i = 1; i < workerCount; i++)
+	{
+		m_threads.emplace_back(&CollisionJobSystem::WorkerLoop, this, i, m_generation);
+	}
+}
+
+void CollisionJobSystem::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopping = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+
+	m_threads.clear();
+	m_queues.clear();
+}
+
+void CollisionJobSystem::ParallelFor(int jobCount, const TJobSignature& job)
+{
+	if (jobCount <= 0)
+		return;
+
+	//not worth waking anyone
+	if (m_threads.empty() || jobCount == 1)
+	{
+		for (int i = 0; i < jobCount; i++)
+		{
+			job(i, 0);
+		}
+		return;
+	}
+
+	//contiguous ranges keep neighbouring jobs (and their cache lines) on one worker
+	const int workerCount = GetWorkerCount();
+	for (int worker = 0; worker < workerCount; worker++)
+	{
+		const int begin = static_cast<int>(static_cast<long long>(jobCount) * worker / workerCount);
+		const int end = static_cast<int>(static_cast<long long>(jobCount) * (worker + 1) / workerCount);
+
+		WorkerQueue& queue = *m_queues[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		assert(queue.jobs.empty());
+		for (int i = begin; i < end; i++)
+		{
+			queue.jobs.push_back(i);
+		}
+	}
+
+	m_remainingJobs = jobCount;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_currentJob = &job;
+		m_busyThreads = static_cast<int>(m_threads.size());
+		m_generation++;
+	}
+	m_wakeCondition.notify_all();
+
+	RunJobs(0);
+
+	//every thread has to check in, none of them may touch job after returning
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_busyThreads == 0; });
+	m_currentJob = nullptr;
+
+	assert(m_remainingJobs == 0);
+}
+
+void CollisionJobSystem::WorkerLoop(int workerIndex, int seenGeneration)
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [&]() { return m_isStopping || m_generation != seenGeneration; });
+
+			if (m_isStopping)
+				return;
+
+			seenGeneration = m_generation;
+		}
+
+		RunJobs(workerIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busyThreads--;
+		}
+		m_doneCondition.notify_one();
+	}
+}
+
+void CollisionJobSystem::RunJobs(int workerIndex)
+{
+	int jobIndex;
+	while (m_remainingJobs > 0 && PopJob(workerIndex, jobIndex))
+	{
+		(*m_currentJob)(jobIndex, workerIndex);
+		m_remainingJobs--;
+	}
+}
+
+bool CollisionJobSystem::PopJob(int workerIndex, int& outJobIndex)
+{
+	//own deque first (back), then steal from the others (front)
+	{
+		WorkerQueue& queue = *m_queues[workerIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			outJobIndex = queue.jobs.back();
+			queue.jobs.pop_back();
+			return true;
+		}
+	}
+
+	const int workerCount = GetWorkerCount();
+	for (int i = 1; i < workerCount; i++)
+	{
+		WorkerQueue& victim = *m_queues[(workerIndex + i) % workerCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty())
+		{
+			outJobIndex = victim.jobs.front();
+			victim.jobs.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
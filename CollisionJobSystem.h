@@ -0,0 +1,56 @@
+#pragma once
+
+//small work-stealing thread pool for the collision detection phase.
+//ParallelFor hands every worker a contiguous range of the jobs in its own deque; a worker pops
+//from the back of its deque and steals from the front of the others once it runs dry.
+//the calling thread takes part as worker 0, so ParallelFor returns once all jobs ran
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CollisionJobSystem
+{
+public:
+	using TJobSignature = std::function<void(int jobIndex, int workerIndex)>;
+
+	~CollisionJobSystem();
+
+	//workerCount includes the calling thread, 0 picks the hardware concurrency
+	void Start(int workerCount);
+	void Stop();
+	int GetWorkerCount() const { return static_cast<int>(m_queues.size()); }
+
+	//jobs must not call back into ParallelFor
+	void ParallelFor(int jobCount, const TJobSignature& job);
+
+private:
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<int> jobs;
+	};
+
+	void WorkerLoop(int workerIndex, int seenGeneration);
+	void RunJobs(int workerIndex);
+	bool PopJob(int workerIndex, int& outJobIndex);
+
+	std::vector<std::thread> m_threads;
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	const TJobSignature* m_currentJob = nullptr;
+	int m_generation = 0;
+	int m_busyThreads = 0;
+	bool m_isStopping = false;
+
+	std::atomic<int> m_remainingJobs{ 0 };
+};
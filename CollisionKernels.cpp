@@ -0,0 +1,462 @@
+#include "CollisionKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COLLISION_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+//MSVC compiles intrinsics for any target, gcc/clang need the target enabled per function
+#if defined(COLLISION_KERNELS_X86) && !defined(_MSC_VER)
+#define COLLISION_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define COLLISION_TARGET_AVX2
+#endif
+
+#include <cmath>
+
+namespace
+{
+	using TCircleBatchKernel = int(*)(float, float, float, const float*, const float*, const float*, int, int*);
+	using TBoxBatchKernel = int(*)(float, float, float, float, const float*, const float*, const float*, const float*, int, int*);
+	using TRaycastCircleBatchKernel = int(*)(float, float, float, float, const float*, const float*, const float*, int, float&);
+
+	int TestCircleBatch_Scalar(float x, float y, float radius, const float* xs, const float* ys, const float* radii, int count, int* outHits)
+	{
+		int hitCount = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const float dx = xs[i] - x;
+			const float dy = ys[i] - y;
+			const float radiusSum = radii[i] + radius;
+
+			//branchless write, the slot is only kept on overlap
+			outHits[hitCount] = i;
+			hitCount += (dx * dx + dy * dy < radiusSum * radiusSum) ? 1 : 0;
+		}
+		return hitCount;
+	}
+
+	int TestBoxBatch_Scalar(float minX, float minY, float maxX, float maxY, const float* minXs, const float* minYs, const float* maxXs, const float* maxYs, int count, int* outHits)
+	{
+		int hitCount = 0;
+		for (int i = 0; i < count; i++)
+		{
+			outHits[hitCount] = i;
+			hitCount += (minXs[i] <= maxX && maxXs[i] >= minX && minYs[i] <= maxY && maxYs[i] >= minY) ? 1 : 0;
+		}
+		return hitCount;
+	}
+
+	//|origin + t * delta - center| = radius, the entering root: t = (-b - sqrt(b^2 - a * c)) / a
+	int RaycastCircleBatch_Scalar(float originX, float originY, float deltaX, float deltaY, const float* xs, const float* ys, const float* radii, int count, float& inOutFraction)
+	{
+		const float a = deltaX * deltaX + deltaY * deltaY;
+
+		int nearest = -1;
+		for (int i = 0; i < count; i++)
+		{
+			const float mx = originX - xs[i];
+			const float my = originY - ys[i];
+			const float b = mx * deltaX + my * deltaY;
+			const float c = mx * mx + my * my - radii[i] * radii[i];
+
+			float t;
+			if (c <= 0.f)
+				t = 0.f;
+			else
+			{
+				const float discriminant = b * b - a * c;
+				if (discriminant < 0.f || b >= 0.f)
+					continue;
+				t = (-b - std::sqrt(discriminant)) / a;
+			}
+
+			if (t < inOutFraction)
+			{
+				inOutFraction = t;
+				nearest = i;
+			}
+		}
+		return nearest;
+	}
+
+#ifdef COLLISION_KERNELS_X86
+
+	inline int CountTrailingZeros(unsigned int mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	//remainder that does not fill a full register, indices are shifted back to the whole batch
+	inline int TestCircleBatchTail(int offset, float x, float y, float radius, const float* xs, const float* ys, const float* radii, int count, int* outHits)
+	{
+		const int hitCount = TestCircleBatch_Scalar(x, y, radius, xs + offset, ys + offset, radii + offset, count - offset, outHits);
+		for (int i = 0; i < hitCount; i++)
+		{
+			outHits[i] += offset;
+		}
+		return hitCount;
+	}
+
+	int TestCircleBatch_SSE2(float x, float y, float radius, const float* xs, const float* ys, const float* radii, int count, int* outHits)
+	{
+		const __m128 px = _mm_set1_ps(x);
+		const __m128 py = _mm_set1_ps(y);
+		const __m128 pr = _mm_set1_ps(radius);
+
+		int hitCount = 0;
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + i), px);
+			const __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + i), py);
+			const __m128 radiusSum = _mm_add_ps(_mm_loadu_ps(radii + i), pr);
+
+			const __m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmplt_ps(distanceSquared, _mm_mul_ps(radiusSum, radiusSum))));
+
+			while (mask != 0)
+			{
+				outHits[hitCount++] = i + CountTrailingZeros(mask);
+				mask &= mask - 1;
+			}
+		}
+
+		return hitCount + TestCircleBatchTail(i, x, y, radius, xs, ys, radii, count, outHits + hitCount);
+	}
+
+	inline int TestBoxBatchTail(int offset, float minX, float minY, float maxX, float maxY, const float* minXs, const float* minYs, const float* maxXs, const float* maxYs, int count, int* outHits)
+	{
+		const int hitCount = TestBoxBatch_Scalar(minX, minY, maxX, maxY, minXs + offset, minYs + offset, maxXs + offset, maxYs + offset, count - offset, outHits);
+		for (int i = 0; i < hitCount; i++)
+		{
+			outHits[i] += offset;
+		}
+		return hitCount;
+	}
+
+	int TestBoxBatch_SSE2(float minX, float minY, float maxX, float maxY, const float* minXs, const float* minYs, const float* maxXs, const float* maxYs, int count, int* outHits)
+	{
+		const __m128 bMinX = _mm_set1_ps(minX);
+		const __m128 bMinY = _mm_set1_ps(minY);
+		const __m128 bMaxX = _mm_set1_ps(maxX);
+		const __m128 bMaxY = _mm_set1_ps(maxY);
+
+		int hitCount = 0;
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 overlapsX = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minXs + i), bMaxX), _mm_cmpge_ps(_mm_loadu_ps(maxXs + i), bMinX));
+			const __m128 overlapsY = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minYs + i), bMaxY), _mm_cmpge_ps(_mm_loadu_ps(maxYs + i), bMinY));
+			unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(_mm_and_ps(overlapsX, overlapsY)));
+
+			while (mask != 0)
+			{
+				outHits[hitCount++] = i + CountTrailingZeros(mask);
+				mask &= mask - 1;
+			}
+		}
+
+		return hitCount + TestBoxBatchTail(i, minX, minY, maxX, maxY, minXs, minYs, maxXs, maxYs, count, outHits + hitCount);
+	}
+
+	//lane results of a vectorized raycast plus the scalar remainder, reduced to the nearest (lowest index on ties)
+	inline int ReduceRaycastLanes(const float* laneFractions, const int* laneIndices, int laneCount, int offset,
+		float originX, float originY, float deltaX, float deltaY, const float* xs, const float* ys, const float* radii, int count, float& inOutFraction)
+	{
+		int nearest = -1;
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			if (laneIndices[lane] != -1 && (laneFractions[lane] < inOutFraction || (laneFractions[lane] == inOutFraction && laneIndices[lane] < nearest)))
+			{
+				inOutFraction = laneFractions[lane];
+				nearest = laneIndices[lane];
+			}
+		}
+
+		const int tailNearest = RaycastCircleBatch_Scalar(originX, originY, deltaX, deltaY, xs + offset, ys + offset, radii + offset, count - offset, inOutFraction);
+		return tailNearest != -1 ? offset + tailNearest : nearest;
+	}
+
+	int RaycastCircleBatch_SSE2(float originX, float originY, float deltaX, float deltaY, const float* xs, const float* ys, const float* radii, int count, float& inOutFraction)
+	{
+		const __m128 ox = _mm_set1_ps(originX);
+		const __m128 oy = _mm_set1_ps(originY);
+		const __m128 dx = _mm_set1_ps(deltaX);
+		const __m128 dy = _mm_set1_ps(deltaY);
+		const __m128 a = _mm_set1_ps(deltaX * deltaX + deltaY * deltaY);
+		const __m128 zero = _mm_setzero_ps();
+
+		__m128 bestFraction = _mm_set1_ps(inOutFraction);
+		__m128i bestIndex = _mm_set1_epi32(-1);
+		__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+		const __m128i step = _mm_set1_epi32(4);
+
+		int i = 0;
+		for (; i + 4 <= count; i += 4, index = _mm_add_epi32(index, step))
+		{
+			const __m128 mx = _mm_sub_ps(ox, _mm_loadu_ps(xs + i));
+			const __m128 my = _mm_sub_ps(oy, _mm_loadu_ps(ys + i));
+			const __m128 r = _mm_loadu_ps(radii + i);
+			const __m128 b = _mm_add_ps(_mm_mul_ps(mx, dx), _mm_mul_ps(my, dy));
+			const __m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my)), _mm_mul_ps(r, r));
+			const __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+
+			//no blend in SSE2, and / andnot / or it is
+			const __m128 isInside = _mm_cmple_ps(c, zero);
+			const __m128 isCrossing = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_cmplt_ps(b, zero));
+			const __m128 t = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(_mm_max_ps(discriminant, zero))), a);
+			const __m128 fraction = _mm_andnot_ps(isInside, t);
+
+			const __m128 isCloser = _mm_and_ps(_mm_or_ps(isInside, isCrossing), _mm_cmplt_ps(fraction, bestFraction));
+			bestFraction = _mm_or_ps(_mm_and_ps(isCloser, fraction), _mm_andnot_ps(isCloser, bestFraction));
+			const __m128i isCloserInt = _mm_castps_si128(isCloser);
+			bestIndex = _mm_or_si128(_mm_and_si128(isCloserInt, index), _mm_andnot_si128(isCloserInt, bestIndex));
+		}
+
+		alignas(16) float laneFractions[4];
+		alignas(16) int laneIndices[4];
+		_mm_store_ps(laneFractions, bestFraction);
+		_mm_store_si128(reinterpret_cast<__m128i*>(laneIndices), bestIndex);
+
+		return ReduceRaycastLanes(laneFractions, laneIndices, 4, i, originX, originY, deltaX, deltaY, xs, ys, radii, count, inOutFraction);
+	}
+
+	COLLISION_TARGET_AVX2
+	int TestCircleBatch_AVX2(float x, float y, float radius, const float* xs, const float* ys, const float* radii, int count, int* outHits)
+	{
+		const __m256 px = _mm256_set1_ps(x);
+		const __m256 py = _mm256_set1_ps(y);
+		const __m256 pr = _mm256_set1_ps(radius);
+
+		int hitCount = 0;
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + i), px);
+			const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + i), py);
+			const __m256 radiusSum = _mm256_add_ps(_mm256_loadu_ps(radii + i), pr);
+
+			const __m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_cmp_ps(distanceSquared, _mm256_mul_ps(radiusSum, radiusSum), _CMP_LT_OQ)));
+
+			while (mask != 0)
+			{
+				outHits[hitCount++] = i + CountTrailingZeros(mask);
+				mask &= mask - 1;
+			}
+		}
+
+		return hitCount + TestCircleBatchTail(i, x, y, radius, xs, ys, radii, count, outHits + hitCount);
+	}
+
+	COLLISION_TARGET_AVX2
+	int TestBoxBatch_AVX2(float minX, float minY, float maxX, float maxY, const float* minXs, const float* minYs, const float* maxXs, const float* maxYs, int count, int* outHits)
+	{
+		const __m256 bMinX = _mm256_set1_ps(minX);
+		const __m256 bMinY = _mm256_set1_ps(minY);
+		const __m256 bMaxX = _mm256_set1_ps(maxX);
+		const __m256 bMaxY = _mm256_set1_ps(maxY);
+
+		int hitCount = 0;
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 overlapsX = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(minXs + i), bMaxX, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(maxXs + i), bMinX, _CMP_GE_OQ));
+			const __m256 overlapsY = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(minYs + i), bMaxY, _CMP_LE_OQ), _mm256_cmp_ps(_mm256_loadu_ps(maxYs + i), bMinY, _CMP_GE_OQ));
+			unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_and_ps(overlapsX, overlapsY)));
+
+			while (mask != 0)
+			{
+				outHits[hitCount++] = i + CountTrailingZeros(mask);
+				mask &= mask - 1;
+			}
+		}
+
+		return hitCount + TestBoxBatchTail(i, minX, minY, maxX, maxY, minXs, minYs, maxXs, maxYs, count, outHits + hitCount);
+	}
+
+	COLLISION_TARGET_AVX2
+	int RaycastCircleBatch_AVX2(float originX, float originY, float deltaX, float deltaY, const float* xs, const float* ys, const float* radii, int count, float& inOutFraction)
+	{
+		const __m256 ox = _mm256_set1_ps(originX);
+		const __m256 oy = _mm256_set1_ps(originY);
+		const __m256 dx = _mm256_set1_ps(deltaX);
+		const __m256 dy = _mm256_set1_ps(deltaY);
+		const __m256 a = _mm256_set1_ps(deltaX * deltaX + deltaY * deltaY);
+		const __m256 zero = _mm256_setzero_ps();
+
+		__m256 bestFraction = _mm256_set1_ps(inOutFraction);
+		__m256i bestIndex = _mm256_set1_epi32(-1);
+		__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i step = _mm256_set1_epi32(8);
+
+		int i = 0;
+		for (; i + 8 <= count; i += 8, index = _mm256_add_epi32(index, step))
+		{
+			const __m256 mx = _mm256_sub_ps(ox, _mm256_loadu_ps(xs + i));
+			const __m256 my = _mm256_sub_ps(oy, _mm256_loadu_ps(ys + i));
+			const __m256 r = _mm256_loadu_ps(radii + i);
+			const __m256 b = _mm256_add_ps(_mm256_mul_ps(mx, dx), _mm256_mul_ps(my, dy));
+			const __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(mx, mx), _mm256_mul_ps(my, my)), _mm256_mul_ps(r, r));
+			const __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+
+			const __m256 isInside = _mm256_cmp_ps(c, zero, _CMP_LE_OQ);
+			const __m256 isCrossing = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ), _mm256_cmp_ps(b, zero, _CMP_LT_OQ));
+			const __m256 t = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, b), _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero))), a);
+			const __m256 fraction = _mm256_blendv_ps(t, zero, isInside);
+
+			const __m256 isCloser = _mm256_and_ps(_mm256_or_ps(isInside, isCrossing), _mm256_cmp_ps(fraction, bestFraction, _CMP_LT_OQ));
+			bestFraction = _mm256_blendv_ps(bestFraction, fraction, isCloser);
+			bestIndex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(index), isCloser));
+		}
+
+		alignas(32) float laneFractions[8];
+		alignas(32) int laneIndices[8];
+		_mm256_store_ps(laneFractions, bestFraction);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(laneIndices), bestIndex);
+
+		return ReduceRaycastLanes(laneFractions, laneIndices, 8, i, originX, originY, deltaX, deltaY, xs, ys, radii, count, inOutFraction);
+	}
+
+	bool CpuSupportsAVX2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		__cpuid(info, 1);
+		const bool osUsesXSave = (info[2] & (1 << 27)) != 0;
+		const bool hasAVX = (info[2] & (1 << 28)) != 0;
+		if (!osUsesXSave || !hasAVX || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+#endif
+
+	ECollisionKernelImplementation GetBestImplementation()
+	{
+#ifdef COLLISION_KERNELS_X86
+		if (CpuSupportsAVX2())
+			return ECollisionKernelImplementation::AVX2;
+
+		return ECollisionKernelImplementation::SSE2;
+#else
+		return ECollisionKernelImplementation::Scalar;
+#endif
+	}
+
+	TCircleBatchKernel GetCircleBatchKernel(ECollisionKernelImplementation implementation)
+	{
+		switch (implementation)
+		{
+#ifdef COLLISION_KERNELS_X86
+		case ECollisionKernelImplementation::AVX2: return &TestCircleBatch_AVX2;
+		case ECollisionKernelImplementation::SSE2: return &TestCircleBatch_SSE2;
+#endif
+		default: return &TestCircleBatch_Scalar;
+		}
+	}
+
+	TBoxBatchKernel GetBoxBatchKernel(ECollisionKernelImplementation implementation)
+	{
+		switch (implementation)
+		{
+#ifdef COLLISION_KERNELS_X86
+		case ECollisionKernelImplementation::AVX2: return &TestBoxBatch_AVX2;
+		case ECollisionKernelImplementation::SSE2: return &TestBoxBatch_SSE2;
+#endif
+		default: return &TestBoxBatch_Scalar;
+		}
+	}
+
+	TRaycastCircleBatchKernel GetRaycastCircleBatchKernel(ECollisionKernelImplementation implementation)
+	{
+		switch (implementation)
+		{
+#ifdef COLLISION_KERNELS_X86
+		case ECollisionKernelImplementation::AVX2: return &RaycastCircleBatch_AVX2;
+		case ECollisionKernelImplementation::SSE2: return &RaycastCircleBatch_SSE2;
+#endif
+		default: return &RaycastCircleBatch_Scalar;
+		}
+	}
+
+	ECollisionKernelImplementation s_implementation = GetBestImplementation();
+	TCircleBatchKernel s_circleBatchKernel = GetCircleBatchKernel(s_implementation);
+	TBoxBatchKernel s_boxBatchKernel = GetBoxBatchKernel(s_implementation);
+	TRaycastCircleBatchKernel s_raycastCircleBatchKernel = GetRaycastCircleBatchKernel(s_implementation);
+}
+
+int CollisionKernels::TestCircleBatch(float x, float y, float radius, const float* xs, const float* ys, const float* radii, int count, int* outHits)
+{
+	return s_circleBatchKernel(x, y, radius, xs, ys, radii, count, outHits);
+}
+
+int CollisionKernels::TestBoxBatch(float minX, float minY, float maxX, float maxY, const float* minXs, const float* minYs, const float* maxXs, const float* maxYs, int count, int* outHits)
+{
+	return s_boxBatchKernel(minX, minY, maxX, maxY, minXs, minYs, maxXs, maxYs, count, outHits);
+}
+
+int CollisionKernels::RaycastCircleBatch(float originX, float originY, float deltaX, float deltaY, const float* xs, const float* ys, const float* radii, int count, float& inOutFraction)
+{
+	return s_raycastCircleBatchKernel(originX, originY, deltaX, deltaY, xs, ys, radii, count, inOutFraction);
+}
+
+bool CollisionKernels::IsSupported(ECollisionKernelImplementation implementation)
+{
+	switch (implementation)
+	{
+	case ECollisionKernelImplementation::Scalar: return true;
+#ifdef COLLISION_KERNELS_X86
+	case ECollisionKernelImplementation::SSE2: return true;
+	case ECollisionKernelImplementation::AVX2: return CpuSupportsAVX2();
+#endif
+	default: return false;
+	}
+}
+
+void CollisionKernels::SetImplementation(ECollisionKernelImplementation implementation)
+{
+	if (!IsSupported(implementation))
+		return;
+
+	s_implementation = implementation;
+	s_circleBatchKernel = GetCircleBatchKernel(implementation);
+	s_boxBatchKernel = GetBoxBatchKernel(implementation);
+	s_raycastCircleBatchKernel = GetRaycastCircleBatchKernel(implementation);
+}
+
+ECollisionKernelImplementation CollisionKernels::GetImplementation()
+{
+	return s_implementation;
+}
+
+const char* CollisionKernels::GetImplementationName(ECollisionKernelImplementation implementation)
+{
+	switch (implementation)
+	{
+	case ECollisionKernelImplementation::Scalar: return "scalar";
+	case ECollisionKernelImplementation::SSE2: return "sse2";
+	case ECollisionKernelImplementation::AVX2: return "avx2";
+	}
+	return "";
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+//batched narrowphase kernels over structure-of-arrays shape data.
+//the implementation (scalar / SSE2 / AVX2) is picked at runtime from the CPU features,
+//SetImplementation can force a specific one (e.g. scalar for comparisons)
+
+#include <vector>
+
+enum class ECollisionKernelImplementation
+{
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+//gathered circles of one candidate batch, reused between calls
+struct CollisionCircleBatch
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> radius;
+	std::vector<int> ids;
+
+	void Clear() { x.clear(); y.clear(); radius.clear(); ids.clear(); }
+	void Push(int id, float positionX, float positionY, float circleRadius)
+	{
+		ids.push_back(id);
+		x.push_back(positionX);
+		y.push_back(positionY);
+		radius.push_back(circleRadius);
+	}
+	int Size() const { return static_cast<int>(ids.size()); }
+};
+
+namespace CollisionKernels
+{
+	//tests one circle against count candidate circles by squared distance, no sqrt.
+	//writes the batch indices of the overlapping candidates to outHits (capacity >= count) and returns their number
+	int TestCircleBatch(float x, float y, float radius, const float* xs, const float* ys, const float* radii, int count, int* outHits);
+
+	//tests one box against count candidate boxes (min / max corners), touching counts as overlap like CollisionAABB::Intersects.
+	//writes the batch indices of the overlapping candidates to outHits (capacity >= count) and returns their number
+	int TestBoxBatch(float minX, float minY, float maxX, float maxY, const float* minXs, const float* minYs, const float* maxXs, const float* maxYs, int count, int* outHits);
+
+	//casts the segment origin + t * delta (t in [0, 1]) against count candidate circles, a circle containing the origin is hit at t = 0.
+	//returns the batch index of the nearest circle hit before inOutFraction (lowest index on ties) and lowers inOutFraction to it, -1 on no hit
+	int RaycastCircleBatch(float originX, float originY, float deltaX, float deltaY, const float* xs, const float* ys, const float* radii, int count, float& inOutFraction);
+
+	bool IsSupported(ECollisionKernelImplementation implementation);
+	void SetImplementation(ECollisionKernelImplementation implementation);
+	ECollisionKernelImplementation GetImplementation();
+	const char* GetImplementationName(ECollisionKernelImplementation implementation);
+}
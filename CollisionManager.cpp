@@ -3,1053 +3,3115 @@
 
 
 #include "CollisionManager.h"
+#include "LinearQuadTree.h"
+#include "SpatialHashGrid.h"
+#include "SweepAndPrune.h"
+#include "StaticCollisionIndex.h"
+#include "CollisionJobSystem.h"
+#include "CollisionProfiler.h"
+#include "CollisionReplay.h"
 
 #include "Engine/SFMLMath/SFMLMath.hpp"
-#include "Engine/EntitySystem/EntitySystemDefinitions.h"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
+#include <iostream>
+#include <string>
 
-void QuadTreeNode::Init()
+void QuadTreeNode::Init(sf::Vector2f centerOffset, sf::Vector2u size, int id, int parent, int parentQuarter)
 {
-	int halfWidth = 0.5f * m_size.x;
-	int halfHeigt = 0.5f * m_size.y;
-	m_renderIndexHorizontal = Engine::GetInstance()->GetRenderSystem().AddLine(sf::Vector2f(m_centerOffset.x - halfWidth, m_centerOffset.y), sf::Vector2f(m_centerOffset.x + halfWidth, m_centerOffset.y));
-	m_renderIndexVertical = Engine::GetInstance()->GetRenderSystem().AddLine(sf::Vector2f(m_centerOffset.x, m_centerOffset.y - halfHeigt), sf::Vector2f(m_centerOffset.x, m_centerOffset.y + halfHeigt));
+	m_centerOffset = centerOffset;
+	m_size = size;
+	m_id = id;
+	m_parent = parent;
+	m_parentQuarter = parentQuarter;
+	m_isDestroyed = false;
+	m_nextFreeNode = -1;
+	m_isRestructuringQueued = false;
 
 	for (int quarter = 0; quarter < 4; quarter++)
 	{
-		m_quaterEntryIDs[quarter].assign(m_maxQuarterEntries + 1, -1);
+		m_children[quarter] = -1;
+		m_overflowBucket[quarter] = -1;
+		quaterEntryCount[quarter] = 0;
 	}
+}
+
+void QuadTree::Init(CollisionManager* manager, const QuadTreeConfig& config)
+{
+	m_collisionManager = manager;
+	m_config = config;
+	m_initialConfig = config;
+
+	assert(m_config.leafCapacity > 0 && m_config.leafCapacity < QUADTREE_QUARTER_SLOTS);
+	assert(m_config.mergeCapacity >= 0 && m_config.mergeCapacity < m_config.leafCapacity);
+	assert(!m_config.worldBounds.IsEmpty());
+	assert(m_config.maxRootGrowth >= 0);
+
+	m_rootGrowthCount = 0;
+	m_pendingGrowthBounds = CollisionAABB::Empty();
+
+	//Create Root QT
+	const sf::Vector2f worldSize = m_config.worldBounds.max - m_config.worldBounds.min;
+	m_rootIndex = AllocateNode(0.5f * (m_config.worldBounds.min + m_config.worldBounds.max), sf::Vector2u(worldSize), -1, -1);
+}
+
+void QuadTree::SetConfig(const QuadTreeConfig& config)
+{
+	Clear();
+	FreeNode(m_rootIndex);
+
+	Init(m_collisionManager, config);
+}
+
+QuadTree::~QuadTree()
+{
+	m_observer = nullptr;
+}
 
+void QuadTree::Clear()
+{
+	const int nodeCount = static_cast<int>(m_nodePool.size());
+	for (int i = 0; i < nodeCount; i++)
+	{
+		if (i != m_rootIndex && !m_nodePool[i].IsDestroyed())
+			FreeNode(i);
+	}
+
+	QuadTreeNode& root = m_nodePool[m_rootIndex];
 	for (int quarter = 0; quarter < 4; quarter++)
 	{
-		Entity* pInputPrompt = Engine::GetInstance()->GetEntitySystem().SpawnEntity<Entity>();
-		m_TextEntities[quarter] = pInputPrompt;
-		m_TextCountEntitiesComponents[quarter] = pInputPrompt->AddComponent<TextRenderComponent>();
-		m_TextCountEntitiesComponents[quarter]->SetFontByPath("../Assets/Fonts/Roboto-Light.ttf", true);
-		m_TextCountEntitiesComponents[quarter]->GetText().setString("0");
-		m_TextCountEntitiesComponents[quarter]->CenterText();
-		m_TextCountEntitiesComponents[quarter]->ClearText();
-
-		float x = 1;
-		float y = 1;
-		switch (quarter)
-		{
-		case 0:
-			x = -1;
-			y = -1;
-			break;
-		case 1:
-			y = -1;
-			break;
-		case 2:
-			break;
-		case 3:
-			x = -1;
-			break;
+		while (root.quaterEntryCount[quarter] > 0)
+		{
+			RemoveFromQuarter(root, quarter, GetQuarterEntry(root, quarter, root.quaterEntryCount[quarter] - 1));
 		}
+		root.m_children[quarter] = -1;
+		NotifyQuarterCountChanged(root, quarter);
+	}
 
-		x *= 25.f;
-		y *= 25.f;
+	m_maxCenterEntryRadius = 0.f;
+	m_pendingGrowthBounds = CollisionAABB::Empty();
 
-		pInputPrompt->SetPosition(pInputPrompt->GetPosition() + sf::Vector2f(x, y) + m_centerOffset);
+	for (int QTNodeIndex : m_restructuringQueue)
+	{
+		m_nodePool[QTNodeIndex].m_isRestructuringQueued = false;
 	}
+	m_restructuringQueue.clear();
 }
 
-void QuadTree::Init(CollisionManager* manager)
+void QuadTree::ReserveNodes(int nodeCount)
 {
-	m_collisionManager = manager;
+	m_nodePool.reserve(nodeCount);
+}
+
+int QuadTree::AllocateNode(sf::Vector2f centerOffset, sf::Vector2u size, int parent, int parentQuarter)
+{
+	int index = m_freeNodeHead;
+	if (index != -1)
+	{
+		m_freeNodeHead = m_nodePool[index].m_nextFreeNode;
+	}
+	else
+	{
+		index = static_cast<int>(m_nodePool.size());
+		m_nodePool.emplace_back();
+	}
 
-	sf::Vector2u size = Engine::GetInstance()->GetRenderWindow().getSize();
+	QuadTreeNode& node = m_nodePool[index];
+	node.Init(centerOffset, size, m_quadTreeIDCounter++, parent, parentQuarter);
+	node.m_index = index;
+	AttachToParent(index);
 
-	//Create Root QT
-	m_quadTreeRoot = new QuadTreeNode(sf::Vector2f(0, 0), size, m_quadTreeIDCounter++, -1, m_maxQuarterEntries);
 	m_currentQTCount++;
+	m_peakQTCount = std::max(m_peakQTCount, m_currentQTCount);
 
+	if (m_observer)
+		m_observer->OnQTNodeCreated(node);
 
-	//Input
-	m_inputCallbackId = Engine::GetInstance()->GetInputManager().Register(sf::Keyboard::V, EInputEvent::Released, std::bind(&QuadTree::OnInputPressed, this));
-	m_QTActiveTextEntity = Engine::GetInstance()->GetEntitySystem().SpawnEntity<Entity>();
-	m_QTVisibilityTextComponent = m_QTActiveTextEntity->AddComponent<TextRenderComponent>();
-	m_QTVisibilityTextComponent->SetFontByPath("../Assets/Fonts/Roboto-Light.ttf");
-	m_QTVisibilityTextComponent->GetText().setString("Press 'v': Quadtree-Visualization: " + std::to_string(m_showQT));
-	m_QTActiveTextEntity->SetPosition(sf::Vector2f(-0.5f * size.x + 25, 0.5f * size.y - 50));
+	return index;
 }
 
-void CollisionManager::Init()
+void QuadTree::AttachToParent(int index)
 {
-	m_quadtree = std::make_unique<QuadTree>();
-	m_quadtree->Init(this);
+	QuadTreeNode& node = m_nodePool[index];
+	const int parent = node.m_parent;
+	const int parentQuarter = node.m_parentQuarter;
 
-	sf::Vector2u size = Engine::GetInstance()->GetRenderWindow().getSize();
+	node.m_parentID = parent != -1 ? m_nodePool[parent].m_id : 0;
+	node.m_depth = parent != -1 ? m_nodePool[parent].m_depth + 1 : 0;
+
+	//the parent's region cut at its center, same comparisons as GetQuarter
+	if (parent == -1)
+	{
+		node.m_region = { sf::Vector2f(-FLT_MAX, -FLT_MAX), sf::Vector2f(FLT_MAX, FLT_MAX) };
+	}
+	else
+	{
+		const QuadTreeNode& parentNode = m_nodePool[parent];
+		const sf::Vector2f parentCenter = parentNode.GetCenterOffset();
 
-	//Input
-	m_inputCallbackId = Engine::GetInstance()->GetInputManager().Register(sf::Keyboard::Q, EInputEvent::Released, std::bind(&CollisionManager::OnInputPressed, this));
-	m_QTActiveTextEntity = Engine::GetInstance()->GetEntitySystem().SpawnEntity<Entity>();
-	m_QTActiveTextComponent = m_QTActiveTextEntity->AddComponent<TextRenderComponent>();
-	m_QTActiveTextComponent->SetFontByPath("../Assets/Fonts/Roboto-Light.ttf");
-	m_QTActiveTextComponent->GetText().setString("Press 'q': Activate Quadtree: " + std::to_string(m_useQTCalculation));
-	m_QTActiveTextEntity->SetPosition(sf::Vector2f(-0.5f * size.x + 25, 0.5f * size.y - 80));
+		node.m_region = parentNode.m_region;
+		if (parentQuarter == 0 || parentQuarter == 3)
+			node.m_region.max.x = parentCenter.x;
+		else
+			node.m_region.min.x = parentCenter.x;
 
-	m_BulletCountTextEntity = Engine::GetInstance()->GetEntitySystem().SpawnEntity<Entity>();
-	m_BulletCountTextComponent = m_BulletCountTextEntity->AddComponent<TextRenderComponent>();
-	m_BulletCountTextComponent->SetFontByPath("../Assets/Fonts/Roboto-Light.ttf");
-	m_BulletCountTextComponent->GetText().setString("Bullets: 0");
-	m_BulletCountTextEntity->SetPosition(sf::Vector2f(-0.5f * size.x + 25, -0.5f * size.y + 50));
+		if (parentQuarter == 0 || parentQuarter == 1)
+			node.m_region.max.y = parentCenter.y;
+		else
+			node.m_region.min.y = parentCenter.y;
+	}
 }
 
-int CollisionManager::RegisterShape(Entity* pOwner, const CollisionShape& shape, sf::Vector2f position, bool isStatic, bool isTriggerVolume, const TCollisionCallbackSignature& callback)
+void QuadTree::FreeNode(int index)
 {
-	m_idCounter++;
+	QuadTreeNode& node = m_nodePool[index];
 
-	//checks if its a bullet
-	CollisionEntry& entry = (shape.type == EShapeType::Circle && shape.radius == 10) ?
-		m_shapes_QT.emplace_back() :
-		m_shapes_nonQT.emplace_back();
+	if (m_observer)
+		m_observer->OnQTNodeDestroyed(node);
 
-	if (shape.type == EShapeType::Circle && shape.radius == 10)
+	for (int quarter = 0; quarter < 4; quarter++)
 	{
-#ifdef PRINT_QUADTREE_BEHAVIOUR
-		std::cout << "*** RegisterEntry: " << entry.id << std::endl;
-#endif 
-		m_bulletCount++;
-		m_BulletCountTextComponent->GetText().setString("Bullets: " + std::to_string(m_bulletCount));
-
-		if (m_useQTCalculation)
+		if (node.m_overflowBucket[quarter] != -1)
 		{
-			entry.registeredForQTEntry = true;
+			m_overflowBuckets[node.m_overflowBucket[quarter]].clear();
+			m_freeOverflowBuckets.push_back(node.m_overflowBucket[quarter]);
+			node.m_overflowBucket[quarter] = -1;
 		}
 	}
 
-	entry.id = m_idCounter;
-	entry.pEntity = pOwner;
-	entry.shape = shape;
-	entry.position = position;
-	entry.callback = callback;
-	entry.isStatic = isStatic;
-	entry.isTriggerVolume = isTriggerVolume;
+	node.Destroy();
+	node.m_nextFreeNode = m_freeNodeHead;
+	m_freeNodeHead = index;
+	m_currentQTCount--;
+}
 
-	return entry.id;
+int QuadTree::GetQuarter(const QuadTreeNode& node, sf::Vector2f position) const
+{
+	const sf::Vector2f centerOffset = node.GetCenterOffset();
+
+	if (position.x <= centerOffset.x && position.y <= centerOffset.y) return 0;
+	if (position.x > centerOffset.x && position.y <= centerOffset.y) return 1;
+	if (position.x > centerOffset.x && position.y > centerOffset.y) return 2;
+	return 3;
 }
 
-bool CollisionManager::UnregisterShape(int id)
+void QuadTree::InsertIntoQuarter(QuadTreeNode& node, int quarter, int id)
 {
-	size_t outEntryIndex = 0;
-	bool isQTEntry;
-	if (CollisionEntry* pEntry = FindCollisionEntryById(id, outEntryIndex, isQTEntry))
+	const int count = node.quaterEntryCount[quarter];
+	if (count < QUADTREE_QUARTER_SLOTS)
 	{
-		if (isQTEntry)
+		node.m_quaterEntryIDs[quarter][count] = id;
+	}
+	else
+	{
+		int& bucket = node.m_overflowBucket[quarter];
+		if (bucket == -1)
 		{
-			if (m_isIteratingShapes)
+			if (!m_freeOverflowBuckets.empty())
 			{
-				pEntry->isDeleted = true;
-				m_deletedShapeIndices.push_back(id);
-				//std::cout << "QT Entry not really removed" << '\n';
+				bucket = m_freeOverflowBuckets.back();
+				m_freeOverflowBuckets.pop_back();
 			}
 			else
 			{
-				if (m_useQTCalculation) 
-					m_quadtree->RemoveQTEntry(pEntry, pEntry->QTNode, pEntry->QTNodeQuater, false);
-
-				m_shapes_QT.erase(m_shapes_QT.begin() + outEntryIndex);
-
-				m_bulletCount--;
-				m_BulletCountTextComponent->GetText().setString("Bullets: " + std::to_string(m_bulletCount));
+				bucket = static_cast<int>(m_overflowBuckets.size());
+				m_overflowBuckets.emplace_back();
 			}
 		}
+		m_overflowBuckets[bucket].push_back(id);
+	}
+
+	node.quaterEntryCount[quarter]++;
+}
+
+bool QuadTree::RemoveFromQuarter(QuadTreeNode& node, int quarter, int id)
+{
+	const int count = node.quaterEntryCount[quarter];
+	for (int i = 0; i < count; i++)
+	{
+		if (GetQuarterEntry(node, quarter, i) != id)
+			continue;
+
+		//fill the hole with the last entry, inline slots stay compact
+		const int last = count - 1;
+		const int lastId = GetQuarterEntry(node, quarter, last);
+		if (i < QUADTREE_QUARTER_SLOTS)
+			node.m_quaterEntryIDs[quarter][i] = lastId;
 		else
+			m_overflowBuckets[node.m_overflowBucket[quarter]][i - QUADTREE_QUARTER_SLOTS] = lastId;
+
+		if (last >= QUADTREE_QUARTER_SLOTS)
 		{
-			if (m_isIteratingShapes)
-			{
-				pEntry->isDeleted = true;
-				m_deletedShapeIndices.push_back(id);
-				//std::cout << "Non QT Entry not really removed" << '\n';
-			}
-			else
+			std::vector<int>& bucket = m_overflowBuckets[node.m_overflowBucket[quarter]];
+			bucket.pop_back();
+			if (bucket.empty())
 			{
-				m_shapes_nonQT.erase(m_shapes_nonQT.begin() + outEntryIndex);
+				m_freeOverflowBuckets.push_back(node.m_overflowBucket[quarter]);
+				node.m_overflowBucket[quarter] = -1;
 			}
 		}
 
+		node.quaterEntryCount[quarter]--;
 
+		if (node.m_index == m_rootIndex)
+			RemoveRootStraddler(quarter, id);
 		return true;
 	}
 
 	return false;
 }
 
-
-QuadTreeNode* QuadTree::AddQTEntry(CollisionEntry* entry)
+void QuadTree::TakeQuarterEntries(QuadTreeNode& node, int quarter, std::vector<int>& outIds)
 {
-	QuadTreeNode* currentQTNode = m_quadTreeRoot;
-	const sf::Vector2f position = entry->position;
+	//the whole quarter at once, removing id by id would search the quarter for every entry
+	for (int i = 0; i < node.quaterEntryCount[quarter]; i++)
+	{
+		outIds.push_back(GetQuarterEntry(node, quarter, i));
+	}
 
-	//categorize to right QuadTree
-	int quarter = -1;
-	bool iterate = true;
-	while (iterate)
+	if (node.m_overflowBucket[quarter] != -1)
 	{
-		sf::Vector2f centerOffset = currentQTNode->GetCenterOffset();
+		m_overflowBuckets[node.m_overflowBucket[quarter]].clear();
+		m_freeOverflowBuckets.push_back(node.m_overflowBucket[quarter]);
+		node.m_overflowBucket[quarter] = -1;
+	}
 
-		if (position.x <= centerOffset.x && position.y <= centerOffset.y)
-		{
-			quarter = 0;
+	node.quaterEntryCount[quarter] = 0;
+	if (node.m_index == m_rootIndex)
+		m_rootStraddlerIds[quarter].clear();
 
-			if (currentQTNode->m_nw == nullptr || currentQTNode->m_nw->IsDestroyed()) iterate = false;
-			else currentQTNode = currentQTNode->m_nw;
-		}
-		else if (position.x > centerOffset.x && position.y <= centerOffset.y)
-		{
-			quarter = 1;
+	NotifyQuarterCountChanged(node, quarter);
+}
 
-			if (currentQTNode->m_ne == nullptr || currentQTNode->m_ne->IsDestroyed()) iterate = false;
-			else currentQTNode = currentQTNode->m_ne;
-		}
-		else if (position.x > centerOffset.x && position.y > centerOffset.y)
-		{
-			quarter = 2;
+void QuadTree::UpdateRootStraddler(const CollisionEntry& entry)
+{
+	//FindQuarterForEntry keeps an entry at the root when no loose quarter cell contains its bounds
+	const int quarter = entry.QTNodeQuater;
+	const bool isStraddling = CollisionManager::IsIndexedByBounds(entry) &&
+		!GetQuarterLooseCell(m_nodePool[m_rootIndex], quarter).Contains(CollisionManager::GetEntryAABB(entry));
+
+	std::vector<int>& straddlerIds = m_rootStraddlerIds[quarter];
+	const bool wasStraddling = std::find(straddlerIds.begin(), straddlerIds.end(), entry.id) != straddlerIds.end();
+	if (isStraddling && !wasStraddling)
+		straddlerIds.push_back(entry.id);
+	else if (!isStraddling && wasStraddling)
+		RemoveRootStraddler(quarter, entry.id);
+}
 
-			if (currentQTNode->m_se == nullptr || currentQTNode->m_se->IsDestroyed()) iterate = false;
-			else currentQTNode = currentQTNode->m_se;
-		}
-		else if (position.x <= centerOffset.x && position.y > centerOffset.y)
-		{
-			quarter = 3;
+void QuadTree::RemoveRootStraddler(int quarter, int id)
+{
+	std::vector<int>& straddlerIds = m_rootStraddlerIds[quarter];
+	const auto it = std::find(straddlerIds.begin(), straddlerIds.end(), id);
+	if (it == straddlerIds.end())
+		return;
 
-			if (currentQTNode->m_sw == nullptr || currentQTNode->m_sw->IsDestroyed()) iterate = false;
-			else currentQTNode = currentQTNode->m_sw;
-		}
-	}
+	*it = straddlerIds.back();
+	straddlerIds.pop_back();
+}
 
-#ifdef PRINT_QUADTREE_BEHAVIOUR
-	std::cout << "+++ AddEntry " << entry->id << ": QT: " << currentQTNode->m_id << "/" << quarter << std::endl;
-#endif 
-	
-	for (int i = 0; i < m_maxQuarterEntries + 1; i++)
+CollisionAABB QuadTree::GetQuarterCell(const QuadTreeNode& node, int quarter) const
+{
+	const sf::Vector2f center = node.GetCenterOffset();
+	const sf::Vector2f halfSize(0.5f * node.GetSize().x, 0.5f * node.GetSize().y);
+	const bool isWest = quarter == 0 || quarter == 3;
+	const bool isNorth = quarter == 0 || quarter == 1;
+
+	CollisionAABB cell;
+	cell.min.x = isWest ? center.x - halfSize.x : center.x;
+	cell.max.x = isWest ? center.x : center.x + halfSize.x;
+	cell.min.y = isNorth ? center.y - halfSize.y : center.y;
+	cell.max.y = isNorth ? center.y : center.y + halfSize.y;
+
+	//node sizes are whole numbers, so border cells may end a little short of the world bounds
+	const CollisionAABB& world = m_config.worldBounds;
+	if (cell.min.x - world.min.x < halfSize.x) cell.min.x = -FLT_MAX;
+	if (world.max.x - cell.max.x < halfSize.x) cell.max.x = FLT_MAX;
+	if (cell.min.y - world.min.y < halfSize.y) cell.min.y = -FLT_MAX;
+	if (world.max.y - cell.max.y < halfSize.y) cell.max.y = FLT_MAX;
+
+	return cell;
+}
+
+CollisionAABB QuadTree::GetQuarterLooseCell(const QuadTreeNode& node, int quarter) const
+{
+	const sf::Vector2f looseness(0.25f * node.GetSize().x, 0.25f * node.GetSize().y);
+
+	CollisionAABB cell = GetQuarterCell(node, quarter);
+	cell.min -= looseness;
+	cell.max += looseness;
+	return cell;
+}
+
+CollisionAABB QuadTree::GetQuarterReach(const QuadTreeNode& node, int quarter) const
+{
+	//the loose cells of the quarters below lie in this one's
+	const sf::Vector2f margin(std::max(m_maxCenterEntryRadius, 0.25f * node.GetSize().x), std::max(m_maxCenterEntryRadius, 0.25f * node.GetSize().y));
+
+	CollisionAABB reach = GetQuarterCell(node, quarter);
+	reach.min -= margin;
+	reach.max += margin;
+	return reach;
+}
+
+bool QuadTree::IsInsideRegion(const QuadTreeNode& node, sf::Vector2f position) const
+{
+	return position.x > node.m_region.min.x && position.x <= node.m_region.max.x &&
+		position.y > node.m_region.min.y && position.y <= node.m_region.max.y;
+}
+
+int QuadTree::FindQuarterForEntry(const CollisionEntry& entry, int startQTNodeIndex, int& outQuarter)
+{
+	//center indexed entries go down to the leaf quarter of their position,
+	//bounds indexed ones stop above the first quarter whose loose cell does not contain them
+	const sf::Vector2f position = entry.position;
+	const CollisionAABB bounds = CollisionManager::GetEntryAABB(entry);
+	const bool isIndexedByBounds = CollisionManager::IsIndexedByBounds(entry);
+
+	int QTNodeIndex = startQTNodeIndex;
+	if (QTNodeIndex == -1 || m_nodePool[QTNodeIndex].IsDestroyed())
+		QTNodeIndex = m_rootIndex;
+
+	//climb only as far as needed: up to the first node whose region holds the position
+	//(and whose quarter still contains the bounds), the root holds everything
+	while (QTNodeIndex != m_rootIndex)
 	{
-		if (currentQTNode->m_quaterEntryIDs[quarter][i] == -1)
-		{
-			currentQTNode->m_quaterEntryIDs[quarter][i] = entry->id;
+		m_stats.nodeVisits++;
+
+		const QuadTreeNode& node = m_nodePool[QTNodeIndex];
+		if (IsInsideRegion(node, position) &&
+			(!isIndexedByBounds || GetQuarterLooseCell(node, GetQuarter(node, position)).Contains(bounds)))
 			break;
-		}
+
+		QTNodeIndex = node.m_parent;
 	}
-	currentQTNode->quaterEntryCount[quarter]++;
-	currentQTNode->m_TextCountEntitiesComponents[quarter]->GetText().setString(std::to_string(currentQTNode->quaterEntryCount[quarter]));
 
+	int quarter = GetQuarter(m_nodePool[QTNodeIndex], position);
+	m_stats.nodeVisits++;
+	while (m_nodePool[QTNodeIndex].m_children[quarter] != -1)
+	{
+		m_stats.nodeVisits++;
 
-	entry->QTNodeQuater = quarter;
+		const int child = m_nodePool[QTNodeIndex].m_children[quarter];
+		const int childQuarter = GetQuarter(m_nodePool[child], position);
 
+		if (isIndexedByBounds && !GetQuarterLooseCell(m_nodePool[child], childQuarter).Contains(bounds))
+			break;
 
-	if (currentQTNode->quaterEntryCount[quarter] > m_maxQuarterEntries)
-	{
-		SubdivideQTQuarter(currentQTNode, quarter);
+		QTNodeIndex = child;
+		quarter = childQuarter;
 	}
 
-	return currentQTNode;
+	outQuarter = quarter;
+	return QTNodeIndex;
 }
 
-
-QuadTreeNode* QuadTree::SubdivideQTQuarter(QuadTreeNode* dividedQTNode, int quarter)
+int QuadTree::GetQuarterEntry(const QuadTreeNode& node, int quarter, int i) const
 {
-	sf::Vector2u size = dividedQTNode->GetSize();
-	sf::Vector2u halfSize = sf::Vector2u(0.5f * size.x, 0.5 * size.y);
+	if (i < QUADTREE_QUARTER_SLOTS)
+		return node.m_quaterEntryIDs[quarter][i];
 
-	sf::Vector2f offset = dividedQTNode->GetCenterOffset();
-	sf::Vector2f additionalOffset;
+	return m_overflowBuckets[node.m_overflowBucket[quarter]][i - QUADTREE_QUARTER_SLOTS];
+}
 
+void QuadTree::RefitLooseBounds()
+{
+	RefitLooseBounds(m_rootIndex);
+}
 
-	if (halfSize.x < 20) return nullptr; //cancle subdivide if size smaller than 2x bullet radius
+CollisionAABB QuadTree::RefitLooseBounds(int QTNodeIndex)
+{
+	m_stats.nodeVisits++;
 
+	CollisionAABB nodeBounds = CollisionAABB::Empty();
 
-	
-	switch (quarter)
+	for (int quarter = 0; quarter < 4; quarter++)
 	{
-	case 0:
-		additionalOffset = sf::Vector2f(-0.25f * size.x, -0.25f * size.y);
-		break;
-	case 1:
-		additionalOffset = sf::Vector2f(0.25f * size.x, -0.25f * size.y);
-		break;
-	case 2:
-		additionalOffset = sf::Vector2f(0.25f * size.x, 0.25f * size.y);
-		break;
-	case 3:
-		additionalOffset = sf::Vector2f(-0.25f * size.x, 0.25f * size.y);
-		break;
-	}
-
-	QuadTreeNode* newQTNode = new QuadTreeNode(offset + additionalOffset, halfSize, m_quadTreeIDCounter++, quarter, m_maxQuarterEntries);
-	m_currentQTCount++;
+		CollisionAABB quarterBounds = CollisionAABB::Empty();
 
-#ifdef PRINT_QUADTREE_BEHAVIOUR
-	std::cout << std::endl << "//S// Subdivide: QT: " << dividedQTNode->m_id << "/" << quarter << " --> new QT: " << newQTNode->m_id << " @: " << &newQTNode->m_id << std::endl << std::endl;
-#endif 
+		//a quarter can still hold entries after it got subdivided, until they move on
+		const int count = m_nodePool[QTNodeIndex].quaterEntryCount[quarter];
+		for (int i = 0; i < count; i++)
+		{
+			size_t outEntryIndex = 0;
+			bool isQTEntry;
+			if (const CollisionEntry* entry = m_collisionManager->FindCollisionEntryById(GetQuarterEntry(m_nodePool[QTNodeIndex], quarter, i), outEntryIndex, isQTEntry))
+				quarterBounds.Merge(CollisionManager::GetEntryAABB(*entry));
+		}
 
-	newQTNode->m_parent = dividedQTNode;
-	newQTNode->m_parentID = dividedQTNode->m_id;
+		const int child = m_nodePool[QTNodeIndex].m_children[quarter];
+		if (child != -1)
+			quarterBounds.Merge(RefitLooseBounds(child));
 
-	switch (quarter)
-	{
-	case 0:
-		dividedQTNode->m_nw = newQTNode;
-		break;
-	case 1:
-		dividedQTNode->m_ne = newQTNode;
-		break;
-	case 2:
-		dividedQTNode->m_se = newQTNode;
-		break;
-	case 3:
-		dividedQTNode->m_sw = newQTNode;
-		break;
+		m_nodePool[QTNodeIndex].m_quarterBounds[quarter] = quarterBounds;
+		nodeBounds.Merge(quarterBounds);
 	}
 
-	return newQTNode;
+	return nodeBounds;
 }
 
-
-void QuadTree::RemoveQTEntry(CollisionEntry* entry, QuadTreeNode* QTNode, int quarter, bool ignoreMerging)
+int QuadTree::QueryCandidates(const CollisionAABB& bounds, std::vector<int>& outIds, std::vector<int>& stack) const
 {
-	bool successfullyRemoved = false;
-	for (int i = 0; i < m_maxQuarterEntries + 1; i++)
+	outIds.clear();
+	stack.clear();
+	stack.push_back(m_rootIndex);
+
+	const auto pushIfOverlapping = [this, &bounds, &outIds](int id)
+	{
+		CollisionAABB entryBounds;
+		if (m_collisionManager->GetQTEntryCircleBounds(id, entryBounds) && entryBounds.Intersects(bounds))
+			outIds.push_back(id);
+	};
+
+	int nodeVisits = 0;
+	while (!stack.empty())
 	{
-		if (QTNode->m_quaterEntryIDs[quarter][i] == -1) continue;
+		const int QTNodeIndex = stack.back();
+		stack.pop_back();
+		nodeVisits++;
 
-		//std::cout << "          searching Entry: Found entryIDs: " << quadtree->m_quaterEntryIDs[quarter][i] << " @: " << &quadtree->m_quaterEntryIDs[quarter][i] << '\n';
-		if (QTNode->m_quaterEntryIDs[quarter][i] == entry->id)
+		const QuadTreeNode& QTNode = m_nodePool[QTNodeIndex];
+		for (int quarter = 0; quarter < 4; quarter++)
 		{
-			QTNode->m_quaterEntryIDs[quarter][i] = -1;
-			QTNode->quaterEntryCount[quarter]--;
-			if (QTNode->quaterEntryCount[quarter] == 0)
+			if (QTNode.quaterEntryCount[quarter] == 0 && QTNode.m_children[quarter] == -1)
+				continue;
+
+			if (!GetQuarterReach(QTNode, quarter).Intersects(bounds))
 			{
-				QTNode->m_TextCountEntitiesComponents[quarter]->ClearText();
+				//bounds indexed entries of the root may straddle its center, only those can still reach bounds
+				if (QTNodeIndex == m_rootIndex)
+				{
+					for (int id : m_rootStraddlerIds[quarter])
+					{
+						pushIfOverlapping(id);
+					}
+				}
+				continue;
 			}
-			else
+
+			for (int i = 0; i < QTNode.quaterEntryCount[quarter]; i++)
 			{
-   				QTNode->m_TextCountEntitiesComponents[quarter]->GetText().setString(std::to_string(QTNode->quaterEntryCount[quarter]));
+				pushIfOverlapping(GetQuarterEntry(QTNode, quarter, i));
 			}
-			successfullyRemoved = true;
-			break;
+
+			if (QTNode.m_children[quarter] != -1)
+				stack.push_back(QTNode.m_children[quarter]);
 		}
 	}
-	int remainingQTEntries = 0;
-	for (int i = 0; i < 4; i++)
-	{
-		remainingQTEntries += QTNode->quaterEntryCount[i];
-	}
 
-#ifdef PRINT_QUADTREE_BEHAVIOUR
-	std::cout << "--- RemoveEntry " << entry->id << ": QT: " << m_quadtree->m_id << "/" << quarter << " Remaining QT-Entities: " << remainingQTEntries << "           --> successfull: " << successfullyRemoved << '\n';
-#endif 
+	return nodeVisits;
+}
 
-	if (QTNode->m_id == m_quadTreeRoot->m_id) return;
-	if (ignoreMerging) return;
-	
-	//re-merging
-	
-	if (remainingQTEntries <= m_maxQuarterEntries)
+int QuadTree::QueryLooseNeighbours(const CollisionAABB& bounds, int QTNodeIndex, int quarter, std::vector<int>& outIds, std::vector<int>& stack) const
+{
+	outIds.clear();
+	stack.clear();
+
+	//a pair of two quarters is found from the lower one in tree order: the quarter's own subtree, and at every
+	//node from here up the quarters after the one the search came from. the rest finds this quarter itself
+	const QuadTreeNode& startNode = m_nodePool[QTNodeIndex];
+	if (startNode.m_children[quarter] != -1 && startNode.m_quarterBounds[quarter].Intersects(bounds))
+		stack.push_back(startNode.m_children[quarter]);
+
+	int nodeVisits = 0;
+	for (int ancestorIndex = QTNodeIndex, fromQuarter = quarter; ancestorIndex != -1; )
 	{
-#ifdef PRINT_QUADTREE_BEHAVIOUR
-		std::cout << '\n' << ">>M<< Start Merging" << '\n';
-#endif 
-		if (QTNode->m_nw != nullptr || QTNode->m_ne != nullptr || QTNode->m_se != nullptr || QTNode->m_sw != nullptr)
+		nodeVisits++;
+
+		const QuadTreeNode& ancestor = m_nodePool[ancestorIndex];
+		for (int nextQuarter = fromQuarter + 1; nextQuarter < 4; nextQuarter++)
 		{
-#ifdef PRINT_QUADTREE_BEHAVIOUR
-			std::cout << "THIS QT HAS CHILDREN! DONT MERGE!" << '\n';
-#endif 
-			return;
-		}
+			if (!ancestor.m_quarterBounds[nextQuarter].Intersects(bounds))
+				continue;
 
-		int quadtreeId = QTNode->m_id;
-		QuadTreeNode* parent = FindQTByID(m_quadTreeRoot, QTNode->m_parentID);
-		assert(parent != nullptr);
-		assert(parent->m_nw != nullptr || parent->m_ne != nullptr || parent->m_se != nullptr || parent->m_sw != nullptr);
+			for (int i = 0; i < ancestor.quaterEntryCount[nextQuarter]; i++)
+			{
+				outIds.push_back(GetQuarterEntry(ancestor, nextQuarter, i));
+			}
 
-		bool parentAdressNulled = false;
-		if (parent->m_nw != nullptr && parent->m_nw->m_id == quadtreeId)
-		{
-			parentAdressNulled = true;
-			parent->m_nw = nullptr;
-		}
- 		if (parent->m_ne != nullptr && parent->m_ne->m_id == quadtreeId) 
-		{
-			parentAdressNulled = true;
-			parent->m_ne = nullptr;
-		}
-		if (parent->m_se != nullptr && parent->m_se->m_id == quadtreeId)
-		{
-			parentAdressNulled = true;
-			parent->m_se = nullptr;
-		}
-		if (parent->m_sw != nullptr && parent->m_sw->m_id == quadtreeId) 
-		{
-			parentAdressNulled = true;
-			parent->m_sw = nullptr;
+			if (ancestor.m_children[nextQuarter] != -1)
+				stack.push_back(ancestor.m_children[nextQuarter]);
 		}
 
-		assert(parentAdressNulled);
-
-#ifdef PRINT_QUADTREE_BEHAVIOUR
-		if (parentAdressNulled) 
-			std::cout << "corresponding parent address nulled" << '\n';
-		std::cout << "Merged QT " << m_quadtree->m_id << ": remaining entries : " << remainingQTEntries << " @: " << &m_quadtree->m_id << '\n';
-#endif 
-		
-		QTNode->Destroy();
-		m_currentQTCount--;
+		fromQuarter = ancestor.m_parentQuarter;
+		ancestorIndex = ancestor.m_parent;
+	}
 
+	while (!stack.empty())
+	{
+		const int nodeIndex = stack.back();
+		stack.pop_back();
+		nodeVisits++;
 
-		for (int i = 0; i < 4; i++)
+		const QuadTreeNode& QTNode = m_nodePool[nodeIndex];
+		for (int childQuarter = 0; childQuarter < 4; childQuarter++)
 		{
-			for (int j = 0; j < m_maxQuarterEntries + 1; j++)
-			{
-				int id = QTNode->m_quaterEntryIDs[i][j];
-				if (id == -1) continue;
-
-#ifdef PRINT_QUADTREE_BEHAVIOUR
-				std::cout << "Deleting Entry " << m_quadtree->m_quaterEntryIDs[i][j] << " from merched QT, @: " << &m_quadtree->m_quaterEntryIDs[i][j] << '\n';
-#endif 
-				QTNode->m_quaterEntryIDs[i][j] = -1;
-				QTNode->quaterEntryCount[quarter]--;
-				QTNode->m_TextCountEntitiesComponents[quarter]->GetText().setString(std::to_string(QTNode->quaterEntryCount[quarter]));
-
-				size_t outEntryIndex = 0;
-				bool isQTEntry;
-				CollisionEntry* entryToRebase = m_collisionManager->FindCollisionEntryById(id, outEntryIndex, isQTEntry);
-				UpdateQTEntryAttributes(entryToRebase);
+			if (!QTNode.m_quarterBounds[childQuarter].Intersects(bounds))
+				continue;
 
-				AddQTEntry(entryToRebase);
+			for (int i = 0; i < QTNode.quaterEntryCount[childQuarter]; i++)
+			{
+				outIds.push_back(GetQuarterEntry(QTNode, childQuarter, i));
 			}
-		}
 
-		delete QTNode;
-		QTNode = nullptr;
+			if (QTNode.m_children[childQuarter] != -1)
+				stack.push_back(QTNode.m_children[childQuarter]);
+		}
 	}
-	
+
+	return nodeVisits;
 }
 
+void QuadTree::NotifyQuarterCountChanged(const QuadTreeNode& node, int quarter)
+{
+	if (m_observer)
+		m_observer->OnQTQuarterCountChanged(node, quarter);
+}
 
-QuadTreeNode* QuadTree::UpdateQTEntryAttributes(CollisionEntry* entry)
+void CollisionManager::Init(sf::Vector2u worldSize)
 {
-	QuadTreeNode* currentQuadtree = m_quadTreeRoot;
-	const sf::Vector2f position = entry->position;
+	const sf::Vector2f halfSize(0.5f * worldSize.x, 0.5f * worldSize.y);
 
-	//categorize to right QuadTree
-	int quarter = -1;
-	bool iterate = true;
-	while (iterate)
-	{
-		//std::cout << "TMP: Entry " << entry->id << " in " << currentQuadtree->m_id << std::endl;
-		//std::cout << "TMP: Entry " << entry->id << " in " << currentQuadtree->m_id << std::endl;
+	QuadTreeConfig config;
+	config.worldBounds = { -halfSize, halfSize };
+	Init(config);
+}
 
-		sf::Vector2f centerOffset = currentQuadtree->GetCenterOffset();
+void CollisionManager::Init(const QuadTreeConfig& config)
+{
+	m_quadtree = std::make_unique<QuadTree>();
+	m_quadtree->Init(this, config);
 
-		if (position.x <= centerOffset.x && position.y <= centerOffset.y)
-		{
-			quarter = 0;
-			if (currentQuadtree->m_nw == nullptr || currentQuadtree->m_nw->IsDestroyed()) iterate = false;
-			else currentQuadtree = currentQuadtree->m_nw;
-		}
-		else if (position.x > centerOffset.x && position.y <= centerOffset.y)
-		{
-			quarter = 1;
-			if (currentQuadtree->m_ne == nullptr || currentQuadtree->m_ne->IsDestroyed()) iterate = false;
-			else currentQuadtree = currentQuadtree->m_ne;
-		}
-		else if (position.x > centerOffset.x && position.y > centerOffset.y)
-		{
-			quarter = 2;
-			if (currentQuadtree->m_se == nullptr || currentQuadtree->m_se->IsDestroyed()) iterate = false;
-			else currentQuadtree = currentQuadtree->m_se;
-		}
-		else if (position.x <= centerOffset.x && position.y > centerOffset.y)
-		{
-			quarter = 3;
-			if (currentQuadtree->m_sw == nullptr || currentQuadtree->m_sw->IsDestroyed()) iterate = false;
-			else currentQuadtree = currentQuadtree->m_sw;
-		}
-	}
+	m_linearQuadTree = std::make_unique<LinearQuadTree>();
+	m_hashGrid = std::make_unique<SpatialHashGrid>();
+	m_sweepAndPrune = std::make_unique<SweepAndPrune>();
+	m_staticIndex = std::make_unique<StaticCollisionIndex>();
 
-	entry->QTNodeQuater = quarter;
-	entry->QTNode = currentQuadtree;
-	return currentQuadtree;
+	//the calling thread's detection scratch, SetWorkerThreadCount adds one per worker
+	m_workerContexts.resize(1);
 }
 
-QuadTreeNode* QuadTree::FindQTByID(QuadTreeNode* root, int id)
+//out of line so the rebuilt backends can stay forward declared in the header
+CollisionManager::CollisionManager() = default;
+CollisionManager::~CollisionManager() = default;
+
+void CollisionManager::SetBroadphaseBackend(EBroadphaseBackend backend)
 {
-	if (root == nullptr || root->IsDestroyed())
-	{
-		return nullptr;
-	}
-
-#ifdef PRINT_QUADTREE_BEHAVIOUR
-	std::cout << "-o   Searching QuadtreeID: " << id << " current: " << root->m_id << "/" << m_currentQTCount << " @: " << &root->m_id << '\n';
-#endif 
+	if (backend == m_broadphaseBackend)
+		return;
 
-	if (root->m_id == id)
+	if (m_useQTCalculation)
 	{
-		return root;
+		if (backend != EBroadphaseBackend::QuadTree)
+		{
+			//the other backends are rebuilt every frame, drop the incremental tree
+			m_quadtree->Clear();
+			for (size_t i = 0; i < m_shapes_QT.size(); i++)
+			{
+				m_shapes_QT[i].QTNodeIndex = -1;
+			}
+		}
+		else
+		{
+			ReinsertQTEntries();
+		}
 	}
 
-	else
-	{
-		QuadTreeNode* foundQT = nullptr;
-		foundQT = FindQTByID(root->m_nw, id);
-		if (foundQT != nullptr) return foundQT;
+	m_broadphaseBackend = backend;
+}
 
-		foundQT = FindQTByID(root->m_ne, id);
-		if (foundQT != nullptr) return foundQT;
+void CollisionManager::SetQuadTreeConfig(const QuadTreeConfig& config)
+{
+	//not from a collision callback, the tree is being walked there
+	assert(!m_isIteratingShapes);
 
-		foundQT = FindQTByID(root->m_se, id);
-		if (foundQT != nullptr) return foundQT;
+	//the linear backend picks the new world bounds up on its next rebuild
+	m_quadtree->SetConfig(config);
 
-		foundQT = FindQTByID(root->m_sw, id);
-		if (foundQT != nullptr) return foundQT;
+	if (IsUsingPointerQuadTree())
+		ReinsertQTEntries();
+}
 
-		return nullptr;
+void CollisionManager::ReinsertQTEntries()
+{
+	for (size_t i = 0; i < m_shapes_QT.size(); i++)
+	{
+		m_quadtree->AddQTEntry(&m_shapes_QT[i]);
 	}
+	m_frameStats.reinsertions += m_shapes_QT.size();
 }
 
-void QuadTree::OnInputPressed()
+int CollisionManager::RegisterShape(Entity* pOwner, const CollisionShape& shape, sf::Vector2f position, bool isStatic, bool isTriggerVolume, const TCollisionCallbackSignature& callback,
+	ECollisionIndexPolicy indexPolicy)
 {
-	Engine::GetInstance()->GetRenderSystem().ToggleQuadtreeView();
+	//static shapes are bulk loaded into the static index on the next Update
+	const bool isStaticEntry = isStatic && indexPolicy == ECollisionIndexPolicy::Auto;
+	const bool isQTEntry = !isStaticEntry && indexPolicy != ECollisionIndexPolicy::Unindexed;
+	std::vector<CollisionEntry>& shapes = isQTEntry ? m_shapes_QT : (isStaticEntry ? m_shapes_static : m_shapes_nonQT);
 
-	m_showQT = !m_showQT;
-	m_QTVisibilityTextComponent->GetText().setString("Press 'v': Quadtree-Visualization: " + std::to_string(m_showQT));
-}
+	CollisionEntry& entry = shapes.emplace_back();
+	entry.id = AllocateSlot(isQTEntry, isStaticEntry, shapes.size() - 1);
 
-void CollisionManager::OnInputPressed()
-{
-	if (m_useQTCalculation)
+	entry.pEntity = pOwner;
+	entry.shape = shape;
+	entry.position = position;
+	entry.previousPosition = position;
+	entry.hasCallback = static_cast<bool>(callback);
+	entry.isStatic = isStatic;
+	entry.isTriggerVolume = isTriggerVolume;
+
+	//circles that fit into the smallest cell (the bullets) are indexed by their center
+	entry.isIndexedByBounds = indexPolicy == ECollisionIndexPolicy::Bounds ||
+		(indexPolicy == ECollisionIndexPolicy::Auto && (shape.type != EShapeType::Circle || 2.f * shape.radius > m_quadtree->GetConfig().minCellExtent));
+
+	if (isStaticEntry)
+		m_isStaticIndexDirty = true;
+
+	if (callback)
 	{
-		for (int i = 0; i < m_shapes_QT.size(); i++)
-		{
-			CollisionEntry* entryToRemove = &m_shapes_QT[i];
-			m_quadtree->RemoveQTEntry(entryToRemove, entryToRemove->QTNode, entryToRemove->QTNodeQuater, false);
-		}
+		m_entryCallbacks[entry.id & s_slotIndexMask].callback = callback;
+		m_callbackShapeCount++;
 	}
-	else
+
+	if (isQTEntry)
 	{
-		for (int i = 0; i < m_shapes_QT.size(); i++)
+#ifdef PRINT_QUADTREE_BEHAVIOUR
+		std::cout << "*** RegisterEntry: " << entry.id << std::endl;
+#endif 
+		SetBulletCount(m_bulletCount + 1);
+		m_QTSoA.Push(entry);
+
+		//inserted right away, static shapes never call UpdateShapePosition
+		if (IsUsingPointerQuadTree())
 		{
-			m_shapes_QT[i].registeredForQTEntry = true;
+			m_quadtree->AddQTEntry(&entry);
 		}
-
 	}
 
-	m_useQTCalculation = !m_useQTCalculation;
-	m_QTActiveTextComponent->GetText().setString("Press 'q': Activate Quadtree: " + std::to_string(m_useQTCalculation));
+	if (m_replayRecorder)
+		m_replayRecorder->WriteRegister(entry.id, shape, position, isStatic, isTriggerVolume, entry.hasCallback, indexPolicy);
 
+	return entry.id;
 }
 
-void CollisionManager::UpdateShapePosition(int id, sf::Vector2f newPosition)
+bool CollisionManager::UnregisterShape(int id)
 {
 	size_t outEntryIndex = 0;
 	bool isQTEntry;
 	if (CollisionEntry* pEntry = FindCollisionEntryById(id, outEntryIndex, isQTEntry))
 	{
-		pEntry->position = newPosition;
+		//the deferred removal after the iteration was recorded when it was requested
+		if (m_replayRecorder && !pEntry->isDeleted)
+			m_replayRecorder->WriteUnregister(id);
 
-
-		if (m_useQTCalculation)
+		if (isQTEntry)
 		{
-			if (pEntry->registeredForQTEntry)
+			if (m_isIteratingShapes)
 			{
-				m_quadtree->UpdateQTEntryAttributes(pEntry);
-				m_quadtree->AddQTEntry(pEntry);
-				pEntry->registeredForQTEntry = false;
-				return;
+				pEntry->isDeleted = true;
+				m_QTSoA.flags[outEntryIndex] |= COLLISION_FLAG_DELETED;
+				m_deletedShapeIndices.push_back(id);
+				//std::cout << "QT Entry not really removed" << '\n';
 			}
-
-
-			if (pEntry->QTNode != nullptr)
+			else
 			{
-				int prevQuadTreeQuarter = pEntry->QTNodeQuater;
-				QuadTreeNode* prevQuadTree = pEntry->QTNode;
+				if (IsUsingPointerQuadTree() && pEntry->QTNodeIndex != -1) 
+					m_quadtree->RemoveQTEntry(pEntry, pEntry->QTNodeIndex, pEntry->QTNodeQuater, false);
 
-				m_quadtree->UpdateQTEntryAttributes(pEntry);
-				int updatedQuadTreeQuater = pEntry->QTNodeQuater;
-				QuadTreeNode* updatedQuadTree = pEntry->QTNode;
+				RemoveEntryAt(m_shapes_QT, outEntryIndex);
 
-
-				//same quadtree
-				if (prevQuadTree->m_id == updatedQuadTree->m_id)
-				{
-					//other quater
-					if (prevQuadTreeQuarter != updatedQuadTreeQuater)
-					{
-				#ifdef PRINT_QUADTREE_BEHAVIOUR
-						std::cout << "!!! Entry " << pEntry->id << " simply changed quater !: " << prevQuadTree->m_id << "/" << prevQuadTreeQuarter << " --> " << prevQuadTree->m_id << "/" << updatedQuadTreeQuater << '\n';
-				#endif 
-						m_quadtree->RemoveQTEntry(pEntry, pEntry->QTNode, prevQuadTreeQuarter,true);
-						m_quadtree->AddQTEntry(pEntry);
-					}
-				}
-				//other quadtree
-				else if (prevQuadTree->m_id != updatedQuadTree->m_id)
-				{
-					//quarter got subdivided
-					if (updatedQuadTree->m_parent && prevQuadTree->m_id == updatedQuadTree->m_parent->m_id)
-					{
-				#ifdef PRINT_QUADTREE_BEHAVIOUR
-						std::cout << "!!! Entry " << pEntry->id << "  detected a subdivide!" << " prev: " << prevQuadTree->m_id << "/" << prevQuadTreeQuarter << " new: " << updatedQuadTree->m_id << "/" << updatedQuadTreeQuater << '\n';
-				#endif 
-						m_quadtree->RemoveQTEntry(pEntry, prevQuadTree, prevQuadTreeQuarter, true);
-						m_quadtree->AddQTEntry(pEntry);
-					}
-				
-					//entry simply changed quadtree
-					else
-					{
-				#ifdef PRINT_QUADTREE_BEHAVIOUR
-						std::cout << "!!! Entry " << pEntry->id << " changed quadtree" << " prev: " << prevQuadTree->m_id << "/" << prevQuadTreeQuarter << " new: " << updatedQuadTree->m_id << "/" << updatedQuadTreeQuater << '\n';
-				#endif 
-						m_quadtree->RemoveQTEntry(pEntry, prevQuadTree, prevQuadTreeQuarter, false);
-						m_quadtree->AddQTEntry(pEntry);
-					}
-				}
+				SetBulletCount(m_bulletCount - 1);
 			}
+		}
+		else
+		{
+			const bool isStaticEntry = m_slots[id & s_slotIndexMask].isStaticEntry;
+			if (isStaticEntry)
+				m_isStaticIndexDirty = true;
 
+			if (m_isIteratingShapes)
+			{
+				pEntry->isDeleted = true;
+				m_deletedShapeIndices.push_back(id);
+				//std::cout << "Non QT Entry not really removed" << '\n';
+			}
+			else
+			{
+				RemoveEntryAt(isStaticEntry ? m_shapes_static : m_shapes_nonQT, outEntryIndex);
+			}
 		}
 
+
+		return true;
 	}
+
+	return false;
 }
 
-void CollisionManager::Update(float deltaSeconds)
+
+int QuadTree::AddQTEntry(CollisionEntry* entry, int startQTNodeIndex)
 {
-	// iterate over all shapes
-	// for each shape, check for each OTHER shape whether they overlap
-	// if so, invoke callback
+	//categorize to right QuadTree
+	int quarter;
+	const int currentQTNodeIndex = FindQuarterForEntry(*entry, startQTNodeIndex, quarter);
 
-	// ... if you have real collision resolving: Resolve collision
+	QuadTreeNode& currentQTNode = m_nodePool[currentQTNodeIndex];
 
-	m_isIteratingShapes = true;
+	if (!CollisionManager::IsIndexedByBounds(*entry))
+		m_maxCenterEntryRadius = std::max(m_maxCenterEntryRadius, entry->shape.radius);
 
-#ifdef PRINT_QUADTREE_COLLISIONCHECK
-	std::cout << '\n' << '\n' << '\n';
-#endif
+	QueueRootGrowth(*entry);
 
-	if (m_useQTCalculation)
-	{
-		CheckForQTCollisions(m_quadtree->GetRootNode());
-		CheckForNonQTCollisions();
-	}
-	else
-	{
-		CheckForNonQTCollisions(true);
-	}
+#ifdef PRINT_QUADTREE_BEHAVIOUR
+	std::cout << "+++ AddEntry " << entry->id << ": QT: " << currentQTNode.m_id << "/" << quarter << std::endl;
+#endif 
+	
+	InsertIntoQuarter(currentQTNode, quarter, entry->id);
+	NotifyQuarterCountChanged(currentQTNode, quarter);
 
-	m_isIteratingShapes = false;
+	entry->QTNodeIndex = currentQTNodeIndex;
+	entry->QTNodeQuater = quarter;
+
+	if (currentQTNodeIndex == m_rootIndex)
+		UpdateRootStraddler(*entry);
 
 
-	for (int i = 0; i < m_deletedShapeIndices.size(); i++)
+	//bounds indexed entries can end up in a quarter that is already subdivided
+	if (currentQTNode.quaterEntryCount[quarter] > m_config.leafCapacity && currentQTNode.m_children[quarter] == -1)
 	{
-		//std::cout << "Clearing chached Entry " << m_deletedShapeIndices[i] << '\n';
-		UnregisterShape(m_deletedShapeIndices[i]);
+		QueueRestructuring(currentQTNodeIndex);
 	}
-	m_deletedShapeIndices.clear();
 
+	return currentQTNodeIndex;
 }
 
 
-void CollisionManager::CheckForQTCollisions(QuadTreeNode* root)
+int QuadTree::SubdivideQTQuarter(int dividedQTNodeIndex, int quarter)
 {
-	assert(root != nullptr && !root->IsDestroyed());
+	m_stats.subdivisions++;
 
-	if (root->m_nw != nullptr) CheckForQTCollisions(root->m_nw);
-	else CheckForQTQuarterCollisions(root, 0);
+	const QuadTreeNode& dividedQTNode = m_nodePool[dividedQTNodeIndex];
 
-	if (root == nullptr || root->IsDestroyed())
-	{
-		//std::cout << "QT got destroyed while iterating" << '\n';
-		return;
-	}
+	sf::Vector2u size = dividedQTNode.GetSize();
+	sf::Vector2u halfSize = sf::Vector2u(0.5f * size.x, 0.5 * size.y);
 
-	if (root->m_ne != nullptr) CheckForQTCollisions(root->m_ne);
-	else CheckForQTQuarterCollisions(root, 1);
+	sf::Vector2f offset = dividedQTNode.GetCenterOffset();
+	sf::Vector2f additionalOffset;
 
-	if (root == nullptr || root->IsDestroyed())
-	{
-		//std::cout << "QT got destroyed while iterating" << '\n';
-		return;
-	}
 
-	if (root->m_se != nullptr) CheckForQTCollisions(root->m_se);
-	else CheckForQTQuarterCollisions(root, 2);
+	//cancle subdivide if the quarter gets too small or the tree too deep
+	if (std::max(halfSize.x, halfSize.y) < m_config.minCellExtent) return -1;
+	if (dividedQTNode.m_depth >= m_config.maxDepth) return -1;
 
-	if (root == nullptr || root->IsDestroyed())
+
+	
+	switch (quarter)
 	{
-		//std::cout << "QT got destroyed while iterating" << '\n';
-		return;
+	case 0:
+		additionalOffset = sf::Vector2f(-0.25f * size.x, -0.25f * size.y);
+		break;
+	case 1:
+		additionalOffset = sf::Vector2f(0.25f * size.x, -0.25f * size.y);
+		break;
+	case 2:
+		additionalOffset = sf::Vector2f(0.25f * size.x, 0.25f * size.y);
+		break;
+	case 3:
+		additionalOffset = sf::Vector2f(-0.25f * size.x, 0.25f * size.y);
+		break;
 	}
 
-	if (root->m_sw != nullptr) CheckForQTCollisions(root->m_sw);
-	else CheckForQTQuarterCollisions(root, 3);
+	//may grow the pool, re-fetch node references afterwards
+	const int newQTNodeIndex = AllocateNode(offset + additionalOffset, halfSize, dividedQTNodeIndex, quarter);
+	m_nodePool[dividedQTNodeIndex].m_children[quarter] = newQTNodeIndex;
+
+#ifdef PRINT_QUADTREE_BEHAVIOUR
+	std::cout << std::endl << "//S// Subdivide: QT: " << m_nodePool[dividedQTNodeIndex].m_id << "/" << quarter << " --> new QT: " << m_nodePool[newQTNodeIndex].m_id << " @: " << newQTNodeIndex << std::endl << std::endl;
+#endif 
+
+	return newQTNodeIndex;
 }
 
-void CollisionManager::CheckForQTQuarterCollisions(QuadTreeNode* root, int quarter)
+
+void QuadTree::RemoveQTEntry(CollisionEntry* entry, int QTNodeIndex, int quarter, bool ignoreMerging)
 {
-	int maxEntriesPerQuater = m_quadtree->MaxEntriesPerQuarter();
-	std::vector<int> foundEntries(maxEntriesPerQuater, -1);
+	COLLISION_PROFILE_ZONE("QuadTree::RemoveQTEntry");
 
-	for (int i = 0; i < maxEntriesPerQuater; i++)
-	{
-		if (root->m_quaterEntryIDs[quarter][i] != -1)
-		{
-			foundEntries[i] = root->m_quaterEntryIDs[quarter][i];
-		}
-	}
+	QuadTreeNode& QTNode = m_nodePool[QTNodeIndex];
 
-#ifdef PRINT_QUADTREE_COLLISIONCHECK
+	bool successfullyRemoved = RemoveFromQuarter(QTNode, quarter, entry->id);
+	if (successfullyRemoved)
+		NotifyQuarterCountChanged(QTNode, quarter);
 
-	std::cout << "QT " << root->m_id << "/" << quarter << " holds entries: ";
-	for (int i = 0; i < maxEntriesPerQuater; i++)
+	int remainingQTEntries = 0;
+	for (int i = 0; i < 4; i++)
 	{
-		int foundEntryID = foundEntries[i];
-
-		if (foundEntryID == -1) 
-			continue;
-
-		std::cout << foundEntries[i] << " ";
+		remainingQTEntries += QTNode.quaterEntryCount[i];
 	}
-	std::cout << '\n';
 
+#ifdef PRINT_QUADTREE_BEHAVIOUR
+	std::cout << "--- RemoveEntry " << entry->id << ": QT: " << QTNode.m_id << "/" << quarter << " Remaining QT-Entities: " << remainingQTEntries << "           --> successfull: " << successfullyRemoved << '\n';
 #endif 
 
-	
-	for (int i = 0; i < maxEntriesPerQuater - 1; i++)
-	{
-		if (foundEntries[i] == -1)
-			continue;
+	if (QTNodeIndex == m_rootIndex) return;
+	if (ignoreMerging) return;
 
-		size_t x;
-		bool isQTEntry;
+	//merged at the end of the Update, the entry count may rise again until then
+	if (remainingQTEntries <= m_config.mergeCapacity && !QTNode.HasChildren())
+		QueueRestructuring(QTNodeIndex);
+}
+
+void QuadTree::QueueRestructuring(int QTNodeIndex)
+{
+	QuadTreeNode& QTNode = m_nodePool[QTNodeIndex];
+	if (QTNode.m_isRestructuringQueued)
+		return;
+
+	QTNode.m_isRestructuringQueued = true;
+	m_restructuringQueue.push_back(QTNodeIndex);
+}
+
+void QuadTree::ApplyRestructuring()
+{
+	COLLISION_PROFILE_ZONE("QuadTree::ApplyRestructuring");
 
-		CollisionEntry& lhs = *FindCollisionEntryById(foundEntries[i], x, isQTEntry);
+	if (!m_pendingGrowthBounds.IsEmpty())
+		GrowRoot();
 
-		if (lhs.isDeleted) 
+	//index loop, merging queues the parent
+	for (size_t i = 0; i < m_restructuringQueue.size(); i++)
+	{
+		const int QTNodeIndex = m_restructuringQueue[i];
+		QuadTreeNode& QTNode = m_nodePool[QTNodeIndex];
+		if (QTNode.IsDestroyed() || !QTNode.m_isRestructuringQueued)
 			continue;
 
+		QTNode.m_isRestructuringQueued = false;
 
-		for (int k = i + 1; k < maxEntriesPerQuater; k++)
+		int entryCount = 0;
+		for (int quarter = 0; quarter < 4; quarter++)
 		{
-			if (foundEntries[k] == -1)
-				continue;
+			entryCount += QTNode.quaterEntryCount[quarter];
+		}
 
-			CollisionEntry& rhs = *FindCollisionEntryById(foundEntries[k], x, isQTEntry);
+		if (QTNodeIndex != m_rootIndex && !QTNode.HasChildren() && entryCount <= m_config.mergeCapacity)
+		{
+			MergeQTNode(QTNodeIndex);
+			continue;
+		}
 
-			if (rhs.isDeleted) 
+		for (int quarter = 0; quarter < 4; quarter++)
+		{
+			if (m_nodePool[QTNodeIndex].quaterEntryCount[quarter] <= m_config.leafCapacity || m_nodePool[QTNodeIndex].m_children[quarter] != -1)
 				continue;
 
-			//every bullet has a circle-shape collider, so no shape check here
-			HandleCollision_Circle_Circle(lhs, rhs);
+			const int childIndex = SubdivideQTQuarter(QTNodeIndex, quarter);
+			if (childIndex != -1)
+				PushDownQuarterEntries(QTNodeIndex, quarter, childIndex);
 		}
 	}
-	
 
+	m_restructuringQueue.clear();
 }
 
-void CollisionManager::CheckForNonQTCollisions(bool includeQTEntries)
+void QuadTree::QueueRootGrowth(const CollisionEntry& entry)
 {
+	//outside the root: clamped into a border quarter for now, the root grows over it in the next ApplyRestructuring
+	if (m_rootGrowthCount >= m_config.maxRootGrowth)
+		return;
 
-	//check other-than-bullets (Tanks, Walls...) for Collisions
-	for (int i = 0; i < m_shapes_nonQT.size(); i++)
-	{
-		CollisionEntry& lhs = m_shapes_nonQT[i];
+	const CollisionAABB extent = CollisionManager::IsIndexedByBounds(entry) ? CollisionManager::GetEntryAABB(entry) : CollisionAABB{ entry.position, entry.position };
+	if (!m_config.worldBounds.Contains(extent) && std::isfinite(extent.min.x) && std::isfinite(extent.min.y) && std::isfinite(extent.max.x) && std::isfinite(extent.max.y))
+		m_pendingGrowthBounds.Merge(extent);
+}
 
-		if (lhs.isDeleted)
-			continue;
+void QuadTree::GrowRoot()
+{
+	const CollisionAABB target = m_pendingGrowthBounds;
+	m_pendingGrowthBounds = CollisionAABB::Empty();
 
-		//check for Bullets-Collision
-		for (int k = 0; k < m_shapes_QT.size(); k++)
-		{
-			CollisionEntry& rhs = m_shapes_QT[k];
+	const int oldRootIndex = m_rootIndex;
+	while (m_rootGrowthCount < m_config.maxRootGrowth && !m_config.worldBounds.Contains(target))
+	{
+		//double towards the side the target reaches further out, the old root becomes one quarter of the new one
+		const sf::Vector2f center = m_nodePool[m_rootIndex].GetCenterOffset();
+		const sf::Vector2u size = m_nodePool[m_rootIndex].GetSize();
+		const CollisionAABB& world = m_config.worldBounds;
+		const float directionX = target.max.x - world.max.x >= world.min.x - target.min.x ? 1.f : -1.f;
+		const float directionY = target.max.y - world.max.y >= world.min.y - target.min.y ? 1.f : -1.f;
+		const sf::Vector2f newCenter(center.x + directionX * 0.5f * size.x, center.y + directionY * 0.5f * size.y);
+		const sf::Vector2u newSize(2 * size.x, 2 * size.y);
+
+		const int newRootIndex = AllocateNode(newCenter, newSize, -1, -1);
+		QuadTreeNode& newRoot = m_nodePool[newRootIndex];
+		const int quarter = GetQuarter(newRoot, center);
+		newRoot.m_children[quarter] = m_rootIndex;
+
+		QuadTreeNode& child = m_nodePool[m_rootIndex];
+		child.m_parent = newRootIndex;
+		child.m_parentQuarter = quarter;
+
+		m_rootIndex = newRootIndex;
+		m_config.worldBounds = { newCenter - 0.5f * sf::Vector2f(newSize), newCenter + 0.5f * sf::Vector2f(newSize) };
+		m_rootGrowthCount++;
 
-			if (rhs.isDeleted)
-				continue;
+#ifdef PRINT_QUADTREE_BEHAVIOUR
+		std::cout << "<<G>> Grew root: QT " << newRoot.m_id << " size " << newSize.x << "x" << newSize.y << '\n';
+#endif 
+	}
 
-			switch (lhs.shape.type)
-			{
-			case EShapeType::Circle:
-			{
-				switch (rhs.shape.type)
-				{
-				case EShapeType::Circle:
-					HandleCollision_Circle_Circle(lhs, rhs);
-					break;
-				case EShapeType::Box:
-					HandleCollision_Circle_Box(lhs, rhs);
-					break;
-				}
-				break;
-			}
+	if (m_rootIndex == oldRootIndex)
+		return;
 
-			case EShapeType::Box:
-			{
-				switch (rhs.shape.type)
-				{
-				case EShapeType::Circle:
-					HandleCollision_Circle_Box(rhs, lhs);
-					break;
-				case EShapeType::Box:
-					HandleCollision_Box_Box(lhs, rhs);
-					break;
-				}
-				break;
-			}
-			}
-		}
+	//the old root's entries are all taken out below and added again, under the new root
+	for (std::vector<int>& straddlerIds : m_rootStraddlerIds)
+	{
+		straddlerIds.clear();
+	}
 
-		//check for other-than-bullets Collisions
-		for (int k = i + 1; k < m_shapes_nonQT.size(); k++)
-		{
-			CollisionEntry& rhs = m_shapes_nonQT[k];
+	//the old tree (and the roots in between when it grew more than once) gets its depths and regions under the new root.
+	//entries of nodes that reached out to infinity were clamped into them, they are taken out and added again from there
+	m_mergeScratch.clear();
+	m_queryStack.clear();
+	m_queryStack.push_back(m_rootIndex);
+	while (!m_queryStack.empty())
+	{
+		const int QTNodeIndex = m_queryStack.back();
+		m_queryStack.pop_back();
 
-			if (rhs.isDeleted || i == k)
-				continue;
+		QuadTreeNode& QTNode = m_nodePool[QTNodeIndex];
+		const bool wasOnBorder = QTNode.m_region.min.x == -FLT_MAX || QTNode.m_region.min.y == -FLT_MAX ||
+			QTNode.m_region.max.x == FLT_MAX || QTNode.m_region.max.y == FLT_MAX;
 
-			switch (lhs.shape.type)
-			{
-			case EShapeType::Circle:
-			{
-				switch (rhs.shape.type)
-				{
-				case EShapeType::Circle:
-					HandleCollision_Circle_Circle(lhs, rhs);
-					break;
-				case EShapeType::Box:
-					HandleCollision_Circle_Box(lhs, rhs);
-					break;
-				}
-				break;
-			}
-			case EShapeType::Box:
+		AttachToParent(QTNodeIndex);
+
+		for (int quarter = 0; quarter < 4; quarter++)
+		{
+			if (wasOnBorder && QTNode.quaterEntryCount[quarter] > 0)
 			{
-				switch (rhs.shape.type)
-				{
-				case EShapeType::Circle:
-					HandleCollision_Circle_Box(rhs, lhs);
-					break;
-				case EShapeType::Box:
-					HandleCollision_Box_Box(lhs, rhs);
-					break;
-				}
-				break;
-			}
+				TakeQuarterEntries(QTNode, quarter, m_mergeScratch);
+				QueueRestructuring(QTNodeIndex);
 			}
+
+			if (QTNode.m_children[quarter] != -1)
+				m_queryStack.push_back(QTNode.m_children[quarter]);
 		}
 	}
 
-
-	//include QT-Entries if non-QT calculation should be used for them instead QT Calculation 
-	//(e.g. for testing performance)
-	if (includeQTEntries)
+	//the search climbs from the node the entry was taken out of, most entries stay close by
+	m_stats.reinsertions += m_mergeScratch.size();
+	for (int id : m_mergeScratch)
 	{
-		if (m_shapes_QT.size() == 0) 
-			return;
+		size_t outEntryIndex = 0;
+		bool isQTEntry;
+		CollisionEntry* entry = m_collisionManager->FindCollisionEntryById(id, outEntryIndex, isQTEntry);
+		AddQTEntry(entry, entry->QTNodeIndex);
+	}
 
-		for (int i = 0; i < m_shapes_QT.size() - 1; i++)
-		{
-			CollisionEntry& lhs = m_shapes_QT[i];
+	//beyond maxRootGrowth the rest stays clamped
+	m_pendingGrowthBounds = CollisionAABB::Empty();
+}
 
-			if (lhs.isDeleted)
-				continue;
+void QuadTree::PushDownQuarterEntries(int QTNodeIndex, int quarter, int childIndex)
+{
+	//right away, otherwise the tree would only grow one level per Update. an overfull child quarter queues the child,
+	//which is split further down the same pass
+	m_mergeScratch.clear();
+	TakeQuarterEntries(m_nodePool[QTNodeIndex], quarter, m_mergeScratch);
 
-			for (int k = i + 1; k < m_shapes_QT.size(); k++)
-			{
-				CollisionEntry& rhs = m_shapes_QT[k];
+	//bounds indexed entries that do not fit into the child climb back into the quarter
+	for (int id : m_mergeScratch)
+	{
+		size_t outEntryIndex = 0;
+		bool isQTEntry;
+		AddQTEntry(m_collisionManager->FindCollisionEntryById(id, outEntryIndex, isQTEntry), childIndex);
+	}
+}
 
-				if (rhs.isDeleted)
-					continue;
+void QuadTree::MergeQTNode(int QTNodeIndex)
+{
+	const int parentIndex = m_nodePool[QTNodeIndex].m_parent;
+	const int parentQuarter = m_nodePool[QTNodeIndex].m_parentQuarter;
+	assert(parentIndex != -1 && m_nodePool[parentIndex].m_children[parentQuarter] == QTNodeIndex);
+	m_stats.merges++;
 
-				HandleCollision_Circle_Circle(lhs, rhs);
-			}
+#ifdef PRINT_QUADTREE_BEHAVIOUR
+	std::cout << ">>M<< Merged QT " << m_nodePool[QTNodeIndex].m_id << " into " << m_nodePool[parentIndex].m_id << "/" << parentQuarter << '\n';
+#endif 
+
+	m_nodePool[parentIndex].m_children[parentQuarter] = -1;
+
+	//the node's region is exactly the parent quarter, its entries move over without a search
+	m_mergeScratch.clear();
+	const QuadTreeNode& QTNode = m_nodePool[QTNodeIndex];
+	for (int quarter = 0; quarter < 4; quarter++)
+	{
+		for (int i = 0; i < QTNode.quaterEntryCount[quarter]; i++)
+		{
+			m_mergeScratch.push_back(GetQuarterEntry(QTNode, quarter, i));
 		}
 	}
-}
 
+	FreeNode(QTNodeIndex);
 
+	QuadTreeNode& parent = m_nodePool[parentIndex];
+	for (int id : m_mergeScratch)
+	{
+		size_t outEntryIndex = 0;
+		bool isQTEntry;
+		CollisionEntry* entry = m_collisionManager->FindCollisionEntryById(id, outEntryIndex, isQTEntry);
 
+		InsertIntoQuarter(parent, parentQuarter, id);
+		entry->QTNodeIndex = parentIndex;
+		entry->QTNodeQuater = parentQuarter;
+	}
+	NotifyQuarterCountChanged(parent, parentQuarter);
 
+	//the parent may have become a mergeable leaf itself
+	QueueRestructuring(parentIndex);
+}
 
-void CollisionManager::HandleCollision_Circle_Circle(CollisionEntry& lhs, CollisionEntry& rhs)
+int QuadTree::RelocateQTEntry(CollisionEntry* entry)
 {
+	const int prevQTNodeIndex = entry->QTNodeIndex;
+	const int prevQuarter = entry->QTNodeQuater;
+
+	//most moves never leave their quarter. a border quarter reaches out to infinity, so leaving the root is one of them
+	int quarter;
+	const int QTNodeIndex = FindQuarterForEntry(*entry, prevQTNodeIndex, quarter);
+	if (QTNodeIndex == prevQTNodeIndex && quarter == prevQuarter)
+	{
+		if (QTNodeIndex == m_rootIndex)
+			UpdateRootStraddler(*entry);
+
+		QueueRootGrowth(*entry);
+		return QTNodeIndex;
+	}
+
+	m_stats.reinsertions++;
+
+	//other quarter of the same node, or down into the subdivision of the previous quarter: the node stays, no merge check
+	const bool ignoreMerging = QTNodeIndex == prevQTNodeIndex || m_nodePool[QTNodeIndex].m_parent == prevQTNodeIndex;
+
+#ifdef PRINT_QUADTREE_BEHAVIOUR
+	std::cout << "!!! Entry " << entry->id << " relocated" << " prev: " << prevQTNodeIndex << "/" << prevQuarter << " new: " << QTNodeIndex << "/" << quarter << '\n';
+#endif 
+
+	RemoveQTEntry(entry, prevQTNodeIndex, prevQuarter, ignoreMerging);
+	return AddQTEntry(entry, QTNodeIndex);
+}
+
+void CollisionManager::ToggleQTCalculation()
+{
+	if (m_useQTCalculation)
+	{
+		m_quadtree->Clear();
+		for (size_t i = 0; i < m_shapes_QT.size(); i++)
+		{
+			m_shapes_QT[i].QTNodeIndex = -1;
+		}
+	}
+	else if (m_broadphaseBackend == EBroadphaseBackend::QuadTree)
+	{
+		ReinsertQTEntries();
+	}
+
+	m_useQTCalculation = !m_useQTCalculation;
+}
+
+void CollisionManager::SetBulletCount(int bulletCount)
+{
+	m_bulletCount = bulletCount;
+
+	if (m_debugLayer)
+		m_debugLayer->OnBulletCountChanged(m_bulletCount);
+}
+
+void CollisionManager::UpdateShapePosition(int id, sf::Vector2f newPosition)
+{
+	COLLISION_PROFILE_ZONE("CollisionManager::UpdateShapePosition");
+
+	size_t outEntryIndex = 0;
+	bool isQTEntry;
+	if (CollisionEntry* pEntry = FindCollisionEntryById(id, outEntryIndex, isQTEntry))
+	{
+		if (m_replayRecorder)
+			m_replayRecorder->WriteMove(id, newPosition);
+
+		pEntry->position = newPosition;
+
+		if (isQTEntry && pEntry->isSwept)
+			m_QTSoA.Set(outEntryIndex, *pEntry);
+		else if (isQTEntry)
+			m_QTSoA.SetPosition(outEntryIndex, newPosition);
+		else if (m_slots[id & s_slotIndexMask].isStaticEntry)
+			m_isStaticIndexDirty = true;
+
+
+		if (IsUsingPointerQuadTree() && pEntry->QTNodeIndex != -1)
+			m_quadtree->RelocateQTEntry(pEntry);
+	}
+}
+
+bool CollisionManager::SetShapeSwept(int id, bool isSwept)
+{
+	size_t outEntryIndex = 0;
+	bool isQTEntry;
+	CollisionEntry* pEntry = FindCollisionEntryById(id, outEntryIndex, isQTEntry);
+	if (pEntry == nullptr || pEntry->isDeleted)
+		return false;
+
+	if (isSwept && (pEntry->shape.type != EShapeType::Circle || pEntry->isStatic))
+		return false;
+
+	if (m_replayRecorder)
+		m_replayRecorder->WriteSwept(id, isSwept);
+
+	if (pEntry->isSwept != isSwept)
+		m_sweptShapeCount += isSwept ? 1 : -1;
+
+	pEntry->isSwept = isSwept;
+	pEntry->previousPosition = pEntry->position;
+
+	if (!isQTEntry)
+		return true;
+
+	m_QTSoA.Set(outEntryIndex, *pEntry);
+
+	//the path restarts here, which also ends a teleport's path over the map
+	if (IsUsingPointerQuadTree() && pEntry->QTNodeIndex != -1)
+		m_quadtree->RelocateQTEntry(pEntry);
+
+	return true;
+}
+
+void CollisionManager::Update(float deltaSeconds)
+{
+	// iterate over all shapes
+	// for each shape, check for each OTHER shape whether they overlap
+	// if so, invoke callback
+
+	// ... if you have real collision resolving: Resolve collision
+
+	COLLISION_PROFILE_ZONE("CollisionManager::Update");
+
+	if (m_replayRecorder)
+		m_replayRecorder->WriteUpdate(deltaSeconds);
+
+	if (m_isStaticIndexDirty)
+		RebuildStaticIndex();
+
+	//splits and merges queued since the last Update (moves, registrations, the deferred removals) in one pass,
+	//before the detection so it sees the tree of this frame's positions
+	if (IsUsingPointerQuadTree())
+		m_quadtree->ApplyRestructuring();
+
+	m_contactRecords.clear();
+	m_isIteratingShapes = true;
+
+#ifdef PRINT_QUADTREE_COLLISIONCHECK
+	std::cout << '\n' << '\n' << '\n';
+#endif
+
+	if (m_useQTCalculation && m_broadphaseBackend != EBroadphaseBackend::QuadTree)
+	{
+		CheckForRebuiltBroadphaseCollisions(*GetRebuiltBroadphase());
+		CheckForNonQTCollisions();
+		CheckForStaticCollisions();
+	}
+	else if (m_useQTCalculation)
+	{
+		if (m_QTBoundsMode == EQuadTreeBoundsMode::Loose)
+			m_quadtree->RefitLooseBounds();
+
+		CheckForQTCollisions();
+		CheckForNonQTCollisions();
+		//the QT detection already ran the static queries of the QT entries
+		CheckForStaticCollisions(false);
+	}
+	else
+	{
+		CheckForNonQTCollisions(true);
+		CheckForStaticCollisions();
+	}
+
+	//removals from the callbacks are still deferred
+	DispatchContactCallbacks();
+
+	m_isIteratingShapes = false;
+
+
+	{
+		COLLISION_PROFILE_ZONE("CollisionManager::UnregisterDeferredShapes");
+		for (size_t i = 0; i < m_deletedShapeIndices.size(); i++)
+		{
+			//std::cout << "Clearing chached Entry " << m_deletedShapeIndices[i] << '\n';
+			UnregisterShape(m_deletedShapeIndices[i]);
+		}
+		m_deletedShapeIndices.clear();
+	}
+
+	EndSweeps();
+	DispatchCollisionEvents();
+
+	if (m_contactHandler)
+		m_contactHandler(m_contactRecords);
+
+	EndFrameStats();
+}
+
+void CollisionManager::SetReplayRecorder(std::unique_ptr<CollisionReplayRecorder> recorder)
+{
+	//not from a collision callback, the deferred removals would be missing from the snapshot
+	assert(!m_isIteratingShapes);
+
+	m_replayRecorder = std::move(recorder);
+	if (!m_replayRecorder)
+		return;
+
+	//the configured bounds, playback grows the root again the same way
+	m_replayRecorder->WriteHeader(m_quadtree->GetInitialConfig());
+
+	//the current shapes as registrations, under a policy that puts them into the same container again
+	auto writeShapes = [this](const std::vector<CollisionEntry>& shapes, bool isQTEntry, ECollisionIndexPolicy indexPolicy)
+	{
+		for (const CollisionEntry& entry : shapes)
+		{
+			if (entry.isDeleted)
+				continue;
+
+			const ECollisionIndexPolicy entryPolicy = isQTEntry && entry.isIndexedByBounds ? ECollisionIndexPolicy::Bounds : indexPolicy;
+			m_replayRecorder->WriteRegister(entry.id, entry.shape, entry.position, entry.isStatic, entry.isTriggerVolume, entry.hasCallback, entryPolicy);
+			if (entry.isSwept)
+				m_replayRecorder->WriteSwept(entry.id, true);
+		}
+	};
+
+	writeShapes(m_shapes_static, false, ECollisionIndexPolicy::Auto);
+	writeShapes(m_shapes_QT, true, ECollisionIndexPolicy::Auto);
+	writeShapes(m_shapes_nonQT, false, ECollisionIndexPolicy::Unindexed);
+}
+
+void CollisionManager::EndFrameStats()
+{
+	const QuadTreeStats& treeStats = m_quadtree->GetStats();
+	m_frameStats.nodeVisits += treeStats.nodeVisits;
+	m_frameStats.subdivisions += treeStats.subdivisions;
+	m_frameStats.merges += treeStats.merges;
+	m_frameStats.reinsertions += treeStats.reinsertions;
+	m_quadtree->ResetStats();
+
+	m_frameStats.shapeCount = static_cast<int>(m_shapes_QT.size() + m_shapes_nonQT.size() + m_shapes_static.size());
+	m_frameStats.overlaps = static_cast<long long>(m_contactRecords.size());
+	m_frameStats.allocations += CountContainerGrowth();
+
+	m_lastFrameStats = m_frameStats;
+	if (m_statsRecorder)
+		m_statsRecorder->Push(m_lastFrameStats);
+
+	m_frameStats = CollisionFrameStats();
+	m_frameStats.frame = m_lastFrameStats.frame + 1;
+}
+
+int CollisionManager::CountContainerGrowth()
+{
+	//the containers that grow with the load, a changed capacity is at least one reallocation
+	const size_t capacities[] = {
+		m_shapes_QT.capacity(), m_shapes_nonQT.capacity(), m_shapes_static.capacity(), m_slots.capacity(),
+		m_QTSoA.x.capacity(), m_QTSoA.y.capacity(), m_QTSoA.radius.capacity(), m_QTSoA.flags.capacity(),
+		m_contactRecords.capacity(), m_candidatePairs.capacity(), m_pairKeys.capacity(), m_kernelHits.capacity(), m_leafJobs.capacity(),
+		m_deletedShapeIndices.capacity(), static_cast<size_t>(m_quadtree->GetNodePoolCapacity()), static_cast<size_t>(m_quadtree->GetPeakOverflowBucketCount())
+	};
+
+	const size_t count = sizeof(capacities) / sizeof(capacities[0]);
+	m_trackedCapacities.resize(count);
+
+	int growth = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (capacities[i] != m_trackedCapacities[i])
+			growth++;
+
+		m_trackedCapacities[i] = capacities[i];
+	}
+
+	return growth;
+}
+
+
+int CollisionManager::GatherBoundsEntryCandidates(const CollisionAABB& bounds, CollisionWorkerContext& context, int& outBoundsEntryCount) const
+{
+	std::vector<int>& candidateIds = context.neighbourIds;
+	const int nodeVisits = m_quadtree->QueryCandidates(bounds, candidateIds, context.queryStack);
+
+	//QueryCandidates only hands out live entries
+	const auto centerBegin = std::partition(candidateIds.begin(), candidateIds.end(),
+		[this](int id) { return (m_QTSoA.flags[GetQTDenseIndex(id)] & COLLISION_FLAG_BOUNDS) != 0; });
+	std::sort(candidateIds.begin(), centerBegin);
+	outBoundsEntryCount = static_cast<int>(centerBegin - candidateIds.begin());
+
+	context.circleBatch.Clear();
+	for (int id : candidateIds)
+	{
+		const int denseIndex = GetQTDenseIndex(id);
+		context.circleBatch.Push(id, m_QTSoA.x[denseIndex], m_QTSoA.y[denseIndex], m_QTSoA.radius[denseIndex]);
+	}
+
+	return nodeVisits;
+}
+
+BroadphaseBackend* CollisionManager::GetRebuiltBroadphase() const
+{
+	switch (m_broadphaseBackend)
+	{
+	case EBroadphaseBackend::LinearQuadTree: return m_linearQuadTree.get();
+	case EBroadphaseBackend::HashGrid: return m_hashGrid.get();
+	case EBroadphaseBackend::SweepAndPrune: return m_sweepAndPrune.get();
+	default: return nullptr;
+	}
+}
+
+void CollisionManager::CheckForRebuiltBroadphaseCollisions(BroadphaseBackend& broadphase)
+{
+	COLLISION_PROFILE_ZONE("CollisionManager::CheckForRebuiltBroadphaseCollisions");
+
+	{
+		COLLISION_PROFILE_ZONE("BroadphaseBackend::Build");
+		broadphase.Build(m_QTSoA, GetWorldBounds());
+	}
+	{
+		COLLISION_PROFILE_ZONE("BroadphaseBackend::GeneratePairs");
+		broadphase.GeneratePairs(m_candidatePairs);
+	}
+	m_pairTestCount += broadphase.GetPairTestCount();
+	m_frameStats.broadphaseTests += broadphase.GetPairTestCount();
+
+	//pairs are dense indices, entries only get removed after iterating
+	for (const CollisionPair& pair : m_candidatePairs)
+	{
+		CollisionEntry& lhs = m_shapes_QT[pair.lhs];
+		CollisionEntry& rhs = m_shapes_QT[pair.rhs];
+
+		if (lhs.isDeleted || rhs.isDeleted)
+			continue;
+
+		ResolveCollision(lhs, rhs);
+	}
+}
+
+void CollisionManager::SetWorkerThreadCount(int threadCount)
+{
+	if (threadCount <= 1)
+	{
+		m_jobSystem.reset();
+		m_workerContexts.resize(1);
+		return;
+	}
+
+	if (!m_jobSystem)
+		m_jobSystem = std::make_unique<CollisionJobSystem>();
+
+	m_jobSystem->Start(threadCount);
+	m_workerContexts.clear();
+	m_workerContexts.resize(threadCount);
+}
+
+int CollisionManager::GetWorkerThreadCount() const
+{
+	return m_jobSystem ? m_jobSystem->GetWorkerCount() : 1;
+}
+
+void CollisionManager::CheckForQTCollisions()
+{
+	COLLISION_PROFILE_ZONE("CollisionManager::CheckForQTCollisions");
+
+	m_leafJobs.clear();
+	CollectQTLeafJobs(m_quadtree->GetRootIndex());
+
+	//the moving QT entries query the static index in chunks, see CheckForStaticCollisions
+	if (!m_staticIndex->IsEmpty())
+	{
+		const int count = static_cast<int>(m_shapes_QT.size());
+		for (int begin = 0; begin < count; begin += s_staticQueryJobSize)
+		{
+			QTLeafJob& job = m_leafJobs.emplace_back();
+			job.staticQueryBegin = begin;
+			job.staticQueryEnd = std::min(count, begin + s_staticQueryJobSize);
+		}
+	}
+
+	for (CollisionWorkerContext& context : m_workerContexts)
+	{
+		context.contacts.clear();
+		context.pairTestCount = 0;
+		context.nodeVisitCount = 0;
+	}
+
+	//detection only reads the tree and the SoA, nothing moves until every job is done. resolving moves entries into
+	//quarters that were not visited yet, so even on one thread the pairs are collected first and resolved afterwards
+	auto detect = [this](int jobIndex, int workerIndex)
+	{
+		COLLISION_PROFILE_ZONE("CollisionManager::DetectQTJob");
+
+		QTLeafJob& job = m_leafJobs[jobIndex];
+		CollisionWorkerContext& context = m_workerContexts[workerIndex];
+
+		job.worker = workerIndex;
+		job.contactBegin = static_cast<int>(context.contacts.size());
+		if (job.staticQueryBegin != -1)
+			DetectStaticContacts(job.staticQueryBegin, job.staticQueryEnd, context);
+		else if (job.isBoundsQuery)
+			DetectBoundsEntryContacts(job, context);
+		else
+			DetectQTLeafContacts(job, context);
+		job.contactEnd = static_cast<int>(context.contacts.size());
+	};
+
+	if (m_jobSystem)
+	{
+		m_jobSystem->ParallelFor(static_cast<int>(m_leafJobs.size()), detect);
+	}
+	else
+	{
+		for (int jobIndex = 0; jobIndex < static_cast<int>(m_leafJobs.size()); jobIndex++)
+		{
+			detect(jobIndex, 0);
+		}
+	}
+
+	for (const CollisionWorkerContext& context : m_workerContexts)
+	{
+		m_pairTestCount += context.pairTestCount;
+		m_frameStats.broadphaseTests += context.pairTestCount;
+		m_frameStats.nodeVisits += context.nodeVisitCount;
+	}
+
+	//apply in leaf order, so the result does not depend on which worker stole what.
+	//every contact is measured again from the current positions: an earlier contact may have pushed either side
+	//already, and a callback may have removed it
+	for (const QTLeafJob& job : m_leafJobs)
+	{
+		const std::vector<CollisionContact>& contacts = m_workerContexts[job.worker].contacts;
+
+		for (int i = job.contactBegin; i < job.contactEnd; i++)
+		{
+			size_t x;
+			bool isQTEntry;
+
+			CollisionEntry* lhs = FindCollisionEntryById(contacts[i].lhsId, x, isQTEntry);
+			CollisionEntry* rhs = FindCollisionEntryById(contacts[i].rhsId, x, isQTEntry);
+
+			if (lhs == nullptr || lhs->isDeleted || rhs == nullptr || rhs->isDeleted)
+				continue;
+
+			ResolveCollision(*lhs, *rhs);
+		}
+	}
+}
+
+void CollisionManager::CollectQTLeafJobs(int QTNodeIndex)
+{
+	//loose: every quarter holding entries, its neighbours are queried. strict: the leaf quarters with a pair,
+	//and a query job for every quarter holding bounds indexed entries
+	const QuadTreeNode& QTNode = m_quadtree->GetNode(QTNodeIndex);
+	m_frameStats.nodeVisits++;
+
+	for (int quarter = 0; quarter < 4; quarter++)
+	{
+		const int child = QTNode.m_children[quarter];
+
+		if (m_QTBoundsMode == EQuadTreeBoundsMode::Loose)
+		{
+			if (QTNode.quaterEntryCount[quarter] > 0) m_leafJobs.push_back({ QTNodeIndex, quarter });
+			if (child != -1) CollectQTLeafJobs(child);
+			continue;
+		}
+
+		for (int i = 0; i < QTNode.quaterEntryCount[quarter]; i++)
+		{
+			const int denseIndex = GetQTDenseIndex(m_quadtree->GetQuarterEntry(QTNode, quarter, i));
+			if (denseIndex != -1 && (m_QTSoA.flags[denseIndex] & COLLISION_FLAG_BOUNDS))
+			{
+				QTLeafJob& job = m_leafJobs.emplace_back();
+				job.QTNodeIndex = QTNodeIndex;
+				job.quarter = quarter;
+				job.isBoundsQuery = true;
+				break;
+			}
+		}
+
+		if (child != -1) CollectQTLeafJobs(child);
+		else if (QTNode.quaterEntryCount[quarter] > 1) m_leafJobs.push_back({ QTNodeIndex, quarter });
+	}
+}
+
+void CollisionManager::DetectQTLeafContacts(const QTLeafJob& job, CollisionWorkerContext& context) const
+{
+	const QuadTreeNode& QTNode = m_quadtree->GetNode(job.QTNodeIndex);
+
+	context.entryIds.clear();
+	context.circleBatch.Clear();
+	for (int i = 0; i < QTNode.quaterEntryCount[job.quarter]; i++)
+	{
+		const int id = m_quadtree->GetQuarterEntry(QTNode, job.quarter, i);
+		const int denseIndex = GetQTDenseIndex(id);
+
+		if (denseIndex == -1 || (m_QTSoA.flags[denseIndex] & COLLISION_FLAG_DELETED))
+			continue;
+
+		if ((m_QTSoA.flags[denseIndex] & COLLISION_FLAG_BOUNDS) && m_QTBoundsMode == EQuadTreeBoundsMode::Strict)
+			continue;
+
+		context.entryIds.push_back(id);
+		context.circleBatch.Push(id, m_QTSoA.x[denseIndex], m_QTSoA.y[denseIndex], m_QTSoA.radius[denseIndex]);
+	}
+
+	for (int i = 0; i < context.circleBatch.Size() - 1; i++)
+	{
+		DetectCircleBatchContacts(GetQTDenseIndex(context.circleBatch.ids[i]), context.circleBatch, i + 1, context);
+	}
+
+	if (m_QTBoundsMode != EQuadTreeBoundsMode::Loose)
+		return;
+
+	//pairs with the entries of the other quarters the loose bounds reach into, each pair is found from one side.
+	//one query for the whole quarter, its entries share the climb and the candidates
+	CollisionAABB entryBounds = CollisionAABB::Empty();
+	for (int lhsId : context.entryIds)
+	{
+		entryBounds.Merge(GetEntryAABB(m_shapes_QT[GetQTDenseIndex(lhsId)]));
+	}
+
+	context.nodeVisitCount += m_quadtree->QueryLooseNeighbours(entryBounds, job.QTNodeIndex, job.quarter, context.neighbourIds, context.queryStack);
+
+	context.circleBatch.Clear();
+	for (int rhsId : context.neighbourIds)
+	{
+		const int denseIndex = GetQTDenseIndex(rhsId);
+
+		if (denseIndex == -1 || (m_QTSoA.flags[denseIndex] & COLLISION_FLAG_DELETED))
+			continue;
+
+		context.circleBatch.Push(rhsId, m_QTSoA.x[denseIndex], m_QTSoA.y[denseIndex], m_QTSoA.radius[denseIndex]);
+	}
+
+	for (int lhsId : context.entryIds)
+	{
+		DetectCircleBatchContacts(GetQTDenseIndex(lhsId), context.circleBatch, 0, context);
+	}
+}
+
+void CollisionManager::DetectBoundsEntryContacts(const QTLeafJob& job, CollisionWorkerContext& context) const
+{
+	const QuadTreeNode& QTNode = m_quadtree->GetNode(job.QTNodeIndex);
+
+	//one query for all bounds indexed entries of the quarter, they share the walk and the candidates
+	context.entryIds.clear();
+	CollisionAABB entryBounds = CollisionAABB::Empty();
+	for (int i = 0; i < QTNode.quaterEntryCount[job.quarter]; i++)
+	{
+		const int id = m_quadtree->GetQuarterEntry(QTNode, job.quarter, i);
+		const int denseIndex = GetQTDenseIndex(id);
+
+		if (denseIndex == -1 || (m_QTSoA.flags[denseIndex] & COLLISION_FLAG_DELETED) || !(m_QTSoA.flags[denseIndex] & COLLISION_FLAG_BOUNDS))
+			continue;
+
+		context.entryIds.push_back(id);
+		entryBounds.Merge(GetEntryAABB(m_shapes_QT[denseIndex]));
+	}
+
+	if (context.entryIds.empty())
+		return;
+
+	int boundsEntryCount = 0;
+	context.nodeVisitCount += GatherBoundsEntryCandidates(entryBounds, context, boundsEntryCount);
+
+	for (int lhsId : context.entryIds)
+	{
+		//two bounds indexed entries find each other, only the lower id tests the pair: the candidates from the
+		//first higher bounds indexed id on, which also skips lhs itself
+		const std::vector<int>& candidateIds = context.circleBatch.ids;
+		const int begin = static_cast<int>(std::upper_bound(candidateIds.begin(), candidateIds.begin() + boundsEntryCount, lhsId) - candidateIds.begin());
+		DetectCircleBatchContacts(GetQTDenseIndex(lhsId), context.circleBatch, begin, context);
+	}
+}
+
+void CollisionManager::DetectCircleBatchContacts(int lhsDenseIndex, const CollisionCircleBatch& batch, int begin, CollisionWorkerContext& context) const
+{
+	const int count = batch.Size() - begin;
+	if (count <= 0)
+		return;
+
+	if (context.kernelHits.size() < static_cast<size_t>(count))
+		context.kernelHits.resize(count);
+
+	const float x = m_QTSoA.x[lhsDenseIndex];
+	const float y = m_QTSoA.y[lhsDenseIndex];
+
+	context.pairTestCount += count;
+	const int hitCount = CollisionKernels::TestCircleBatch(x, y, m_QTSoA.radius[lhsDenseIndex],
+		batch.x.data() + begin, batch.y.data() + begin, batch.radius.data() + begin, count, context.kernelHits.data());
+
+	for (int i = 0; i < hitCount; i++)
+	{
+		const int k = begin + context.kernelHits[i];
+		const uint8_t rhsFlags = m_QTSoA.flags[GetQTDenseIndex(batch.ids[k])];
+
+		if (m_QTSoA.flags[lhsDenseIndex] & rhsFlags & COLLISION_FLAG_STATIC)
+			continue;
+
+		const sf::Vector2f lhsToRhs(x - batch.x[k], y - batch.y[k]);
+		const float depth = m_QTSoA.radius[lhsDenseIndex] + batch.radius[k] - sf::getLength(lhsToRhs);
+		const bool isExact = !((m_QTSoA.flags[lhsDenseIndex] | rhsFlags) & COLLISION_FLAGS_SHAPE_TEST);
+
+		//the kernel compares squared distances, drop what the resolve step would reject on the borderline
+		if (isExact && depth <= 0.f)
+			continue;
+
+		CollisionContact& contact = context.contacts.emplace_back();
+		contact.lhsId = m_shapes_QT[lhsDenseIndex].id;
+		contact.rhsId = batch.ids[k];
+	}
+}
+
+bool CollisionManager::GetQTEntryCircleBounds(int id, CollisionAABB& outBounds) const
+{
+	const int denseIndex = GetQTDenseIndex(id);
+	if (denseIndex == -1 || (m_QTSoA.flags[denseIndex] & COLLISION_FLAG_DELETED))
+		return false;
+
+	const float radius = m_QTSoA.radius[denseIndex];
+	outBounds.min = sf::Vector2f(m_QTSoA.x[denseIndex] - radius, m_QTSoA.y[denseIndex] - radius);
+	outBounds.max = sf::Vector2f(m_QTSoA.x[denseIndex] + radius, m_QTSoA.y[denseIndex] + radius);
+	return true;
+}
+
+int CollisionManager::GetQTDenseIndex(int id) const
+{
+	if (!IsValidId(id))
+		return -1;
+
+	const CollisionEntrySlot& slot = m_slots[id & s_slotIndexMask];
+	return slot.isQTEntry ? slot.denseIndex : -1;
+}
+
+void CollisionManager::CheckForNonQTCollisions(bool includeQTEntries)
+{
+	COLLISION_PROFILE_ZONE("CollisionManager::CheckForNonQTCollisions");
+
+	//check unindexed shapes (see ECollisionIndexPolicy) for Collisions
+	for (size_t i = 0; i < m_shapes_nonQT.size(); i++)
+	{
+		CollisionEntry& lhs = m_shapes_nonQT[i];
+
+		if (lhs.isDeleted)
+			continue;
+
+		//check against the indexed shapes, the tree only hands out the ones close to lhs
+		if (IsUsingPointerQuadTree())
+		{
+			m_frameStats.nodeVisits += m_quadtree->QueryCandidates(GetEntryAABB(lhs), m_neighbourEntryScratch, m_queryStack);
+
+			for (int rhsId : m_neighbourEntryScratch)
+			{
+				size_t x;
+				bool isQTEntry;
+
+				CollisionEntry* rhs = FindCollisionEntryById(rhsId, x, isQTEntry);
+
+				if (rhs == nullptr || rhs->isDeleted)
+					continue;
+
+				HandleCollision(lhs, *rhs);
+			}
+		}
+		else
+		{
+			for (size_t k = 0; k < m_shapes_QT.size(); k++)
+			{
+				CollisionEntry& rhs = m_shapes_QT[k];
+
+				if (rhs.isDeleted)
+					continue;
+
+				HandleCollision(lhs, rhs);
+			}
+		}
+
+		//check for other unindexed Collisions
+		for (size_t k = i + 1; k < m_shapes_nonQT.size(); k++)
+		{
+			CollisionEntry& rhs = m_shapes_nonQT[k];
+
+			if (rhs.isDeleted || i == k)
+				continue;
+
+			HandleCollision(lhs, rhs);
+		}
+	}
+
+
+	//include QT-Entries if non-QT calculation should be used for them instead QT Calculation 
+	//(e.g. for testing performance)
+	if (includeQTEntries)
+	{
+		if (m_shapes_QT.size() == 0) 
+			return;
+
+		if (m_kernelHits.size() < m_shapes_QT.size())
+			m_kernelHits.resize(m_shapes_QT.size());
+
+		//the hot data is contiguous here, test each circle against all following ones in one batch
+		for (size_t i = 0; i + 1 < m_shapes_QT.size(); i++)
+		{
+			if (m_QTSoA.flags[i] & COLLISION_FLAG_DELETED)
+				continue;
+
+			const int count = static_cast<int>(m_shapes_QT.size() - i - 1);
+			m_pairTestCount += count;
+			m_frameStats.broadphaseTests += count;
+			const int hitCount = CollisionKernels::TestCircleBatch(m_QTSoA.x[i], m_QTSoA.y[i], m_QTSoA.radius[i],
+				&m_QTSoA.x[i + 1], &m_QTSoA.y[i + 1], &m_QTSoA.radius[i + 1], count, m_kernelHits.data());
+
+			for (int h = 0; h < hitCount; h++)
+			{
+				const size_t k = i + 1 + m_kernelHits[h];
+
+				if (m_QTSoA.flags[k] & COLLISION_FLAG_DELETED)
+					continue;
+
+				ResolveCollision(m_shapes_QT[i], m_shapes_QT[k]);
+			}
+		}
+	}
+}
+
+
+
+
+
+void CollisionManager::RebuildStaticIndex()
+{
+	COLLISION_PROFILE_ZONE("CollisionManager::RebuildStaticIndex");
+
+	//not from a collision callback, the index may be walked there
+	assert(!m_isIteratingShapes);
+
+	m_staticIndex->Build(m_shapes_static);
+	m_isStaticIndexDirty = false;
+}
+
+void CollisionManager::CheckForStaticCollisions(bool includeQTEntries)
+{
+	COLLISION_PROFILE_ZONE("CollisionManager::CheckForStaticCollisions");
+
+	if (m_staticIndex->IsEmpty())
+		return;
+
+	//the moving shapes query the static index, pairs of two static shapes never come up.
+	//ids instead of references, a callback may register shapes and grow the lists
+	if (includeQTEntries)
+	{
+		for (size_t i = 0; i < m_shapes_QT.size(); i++)
+		{
+			if (m_QTSoA.flags[i] & (COLLISION_FLAG_DELETED | COLLISION_FLAG_STATIC))
+				continue;
+
+			const int lhsId = m_shapes_QT[i].id;
+			m_staticIndex->Query(GetEntryAABB(m_shapes_QT[i]), [this, lhsId](int rhsId) { HandleStaticCollision(lhsId, rhsId); });
+		}
+	}
+
+	for (size_t i = 0; i < m_shapes_nonQT.size(); i++)
+	{
+		if (m_shapes_nonQT[i].isDeleted || m_shapes_nonQT[i].isStatic)
+			continue;
+
+		const int lhsId = m_shapes_nonQT[i].id;
+		m_staticIndex->Query(GetEntryAABB(m_shapes_nonQT[i]), [this, lhsId](int rhsId) { HandleStaticCollision(lhsId, rhsId); });
+	}
+}
+
+void CollisionManager::HandleStaticCollision(int lhsId, int rhsId)
+{
+	size_t x;
+	bool isQTEntry;
+
+	CollisionEntry* lhs = FindCollisionEntryById(lhsId, x, isQTEntry);
+	CollisionEntry* rhs = FindCollisionEntryById(rhsId, x, isQTEntry);
+
+	if (lhs == nullptr || lhs->isDeleted || rhs == nullptr || rhs->isDeleted)
+		return;
+
+	HandleCollision(*lhs, *rhs);
+}
+
+void CollisionManager::DetectStaticContacts(int begin, int end, CollisionWorkerContext& context) const
+{
+	for (int i = begin; i < end; i++)
+	{
+		if (m_QTSoA.flags[i] & (COLLISION_FLAG_DELETED | COLLISION_FLAG_STATIC))
+			continue;
+
+		const CollisionEntry& lhs = m_shapes_QT[i];
+		m_staticIndex->Query(GetEntryAABB(lhs), [&](int rhsId)
+		{
+			const CollisionEntry& rhs = m_shapes_static[m_slots[rhsId & s_slotIndexMask].denseIndex];
+			if (rhs.isDeleted)
+				return;
+
+			context.pairTestCount++;
+
+			//circles that do not touch are dropped here, anything with a box or a sweep is shape tested when resolving
+			if (lhs.shape.type == EShapeType::Circle && rhs.shape.type == EShapeType::Circle && !lhs.isSwept)
+			{
+				const sf::Vector2f lhsToRhs = lhs.position - rhs.position;
+				if (lhs.shape.radius + rhs.shape.radius - sf::getLength(lhsToRhs) <= 0.f)
+					return;
+			}
+
+			CollisionContact& contact = context.contacts.emplace_back();
+			contact.lhsId = lhs.id;
+			contact.rhsId = rhsId;
+		});
+	}
+}
+
+void CollisionManager::HandleCollision(CollisionEntry& lhs, CollisionEntry& rhs)
+{
+	//no bounding circle test counted this pair, the shape test is its only one
+	if (!lhs.isStatic || !rhs.isStatic)
+		m_pairTestCount++;
+
+	HandleShapeCollision(lhs, rhs);
+}
+
+void CollisionManager::HandleShapeCollision(CollisionEntry& lhs, CollisionEntry& rhs)
+{
+	m_frameStats.candidatePairs++;
+
+	//static shapes never collide with each other
+	if (lhs.isStatic && rhs.isStatic)
+		return;
+
+	if ((lhs.isSwept || rhs.isSwept) && HandleCollision_Swept(lhs, rhs))
+		return;
+
+	switch (lhs.shape.type)
+	{
+	case EShapeType::Circle:
+	{
+		switch (rhs.shape.type)
+		{
+		case EShapeType::Circle:
+			HandleCollision_Circle_Circle(lhs, rhs);
+			break;
+		case EShapeType::Box:
+			HandleCollision_Circle_Box(lhs, rhs);
+			break;
+		}
+		break;
+	}
+	case EShapeType::Box:
+	{
+		switch (rhs.shape.type)
+		{
+		case EShapeType::Circle:
+			HandleCollision_Circle_Box(rhs, lhs);
+			break;
+		case EShapeType::Box:
+			HandleCollision_Box_Box(lhs, rhs);
+			break;
+		}
+		break;
+	}
+	}
+}
+
+void CollisionManager::ResolveCollision(CollisionEntry& lhs, CollisionEntry& rhs)
+{
+	if (lhs.isStatic && rhs.isStatic)
+		return;
+
+	//the batch kernels only compare bounding circles, anything with a box or a sweep still needs its shape test.
+	//the pair was counted by that test already
+	if (lhs.shape.type == EShapeType::Circle && rhs.shape.type == EShapeType::Circle && !lhs.isSwept && !rhs.isSwept)
+	{
+		m_frameStats.candidatePairs++;
+		ResolveCollision_Circle_Circle(lhs, rhs);
+	}
+	else
+		HandleShapeCollision(lhs, rhs);
+}
+
+void CollisionManager::HandleCollision_Circle_Circle(CollisionEntry& lhs, CollisionEntry& rhs)
+{
+	m_frameStats.narrowphaseTests++;
+
+	//cheap rejection first, length and normal are only needed for overlaps
+	const sf::Vector2f lhsToRhs = lhs.position - rhs.position;
+	const float radiusSum = lhs.shape.radius + rhs.shape.radius;
+
+	if (lhsToRhs.x * lhsToRhs.x + lhsToRhs.y * lhsToRhs.y >= radiusSum * radiusSum)
+		return;
+
+	ResolveCollision_Circle_Circle(lhs, rhs);
+}
+
+void CollisionManager::ResolveCollision_Circle_Circle(CollisionEntry& lhs, CollisionEntry& rhs)
+{
+	const sf::Vector2f lhsToRhs = lhs.position - rhs.position;
+	const float distance = sf::getLength(lhsToRhs);
+	const float distanceBetweenCircles = distance - (lhs.shape.radius + rhs.shape.radius);
+
+	if (distanceBetweenCircles < 0.f)
+		ApplyContact_Circle_Circle(lhs, rhs, sf::getNormalized(lhsToRhs), -distanceBetweenCircles);
+}
+
+void CollisionManager::ApplyContact_Circle_Circle(CollisionEntry& lhs, CollisionEntry& rhs, sf::Vector2f normal, float depth)
+{
+	const float distanceBetweenCircles = -depth;
+
+	sf::Vector2f resolveVectorLhs;
+	sf::Vector2f resolveVectorRhs;
+
+	if (lhs.isTriggerVolume || rhs.isTriggerVolume)
+	{
+		//Handle overlap
+	}
+	else if (!lhs.isTriggerVolume && !rhs.isTriggerVolume)
+	{
+		//Handle collision resolve
+		if (lhs.isStatic != rhs.isStatic)
+		{
+			CollisionEntry& movableEntry = lhs.isStatic ? rhs : lhs;
+			sf::Vector2f& resolveVector = lhs.isStatic ? resolveVectorRhs : resolveVectorLhs;
+			resolveVector = (lhs.isStatic ? normal : -normal) * distanceBetweenCircles;
+
+			MoveOwner(movableEntry, movableEntry.position + resolveVector);
+		}
+		else if (!lhs.isStatic && !rhs.isStatic)
+		{
+			//Both movable move away from each other
+			resolveVectorLhs = normal * distanceBetweenCircles * -0.5f;
+			resolveVectorRhs = normal * distanceBetweenCircles * 0.5f;
+
+			MoveOwner(lhs, lhs.position + resolveVectorLhs);
+			MoveOwner(rhs, rhs.position + resolveVectorRhs);
+		}
+		else
+		{
+			//Both are static, do nothing (both immovable)
+		}
+	}
+
+	NotifyOverlap(lhs, rhs, resolveVectorLhs, resolveVectorRhs);
+}
+
+void CollisionManager::HandleCollision_Circle_Box(CollisionEntry& lhs, CollisionEntry& rhs)
+{
+	m_frameStats.narrowphaseTests++;
+
 	CollisionShape& lhsCircle = lhs.shape;
-	CollisionShape& rhsCircle = rhs.shape;
+	CollisionShape& rhsBox = rhs.shape;
+
+	// get center point circle first 
+	// calculate AABB info (center, half-extents)
+	sf::Vector2f aabb_half_extents(rhsBox.width * 0.5f, rhsBox.height * 0.5f);
+	// get difference vector between both centers
+	sf::Vector2f difference = lhs.position - rhs.position;
+
+	sf::Vector2f clamped;
+	clamped.x = std::clamp(difference.x, -aabb_half_extents.x, aabb_half_extents.x);
+	clamped.y = std::clamp(difference.y, -aabb_half_extents.y, aabb_half_extents.y);
+
+	// now that we know the clamped values, add this to AABB_center and we get the value of box closest to circle
+	sf::Vector2f closest = rhs.position + clamped;
+
+	// now retrieve vector between center circle and closest point AABB and check if length < radius
+	difference = closest - lhs.position;
+
+	if (difference.x == 0.f && difference.y == 0.f)
+		return;
+
+	const float diffLength = sf::getLength(difference);
+
+	if (diffLength < lhsCircle.radius)
+	{
+		const float penetrationDistance = lhsCircle.radius - diffLength;
+
+		sf::Vector2f resolveVectorLhs;
+		sf::Vector2f resolveVectorRhs;
+
+		if (lhs.isTriggerVolume || rhs.isTriggerVolume)
+		{
+			//Handle overlap
+		}
+		else if (!lhs.isTriggerVolume && !rhs.isTriggerVolume)
+		{
+			//Handle collision resolve
+			if (lhs.isStatic != rhs.isStatic)
+			{
+				//Both movable move away from each other
+				sf::Vector2f& resolveVector = lhs.isStatic ? resolveVectorRhs : resolveVectorLhs;
+				CollisionEntry& movableEntry = lhs.isStatic ? rhs : lhs;
+				resolveVector = GetCircleBoxSolveDirection(difference) * penetrationDistance;
+
+				MoveOwner(movableEntry, movableEntry.position - resolveVector);
+			}
+			else if (!lhs.isStatic && !rhs.isStatic)
+			{
+				//Both movable move away from each other
+				sf::Vector2f solveDirection = GetCircleBoxSolveDirection(difference);
+
+				resolveVectorLhs = solveDirection * penetrationDistance * -0.5f;
+				resolveVectorRhs = solveDirection * penetrationDistance * 0.5f;
+
+				MoveOwner(lhs, lhs.position + resolveVectorLhs);
+				MoveOwner(rhs, rhs.position + resolveVectorRhs);
+			}
+			else
+			{
+				//Both are static, do nothing (both immovable)
+			}
+		}
+
+		NotifyOverlap(lhs, rhs, resolveVectorLhs, resolveVectorRhs);
+	}
+}
+
+void CollisionManager::HandleCollision_Box_Box(CollisionEntry& lhs, CollisionEntry& rhs)
+{
+	m_frameStats.narrowphaseTests++;
+
+	//separating axis test of the two AABBs, overlap per axis is the sum of the half extents minus the center distance
+	const sf::Vector2f difference = lhs.position - rhs.position;
+	const float overlapX = 0.5f * (lhs.shape.width + rhs.shape.width) - std::abs(difference.x);
+	const float overlapY = 0.5f * (lhs.shape.height + rhs.shape.height) - std::abs(difference.y);
+
+	if (overlapX <= 0.f || overlapY <= 0.f)
+		return;
+
+	//resolve along the axis of least penetration, normal points from rhs to lhs
+	sf::Vector2f normal;
+	float penetrationDistance;
+	if (overlapX < overlapY)
+	{
+		normal = sf::Vector2f(difference.x < 0.f ? -1.f : 1.f, 0.f);
+		penetrationDistance = overlapX;
+	}
+	else
+	{
+		normal = sf::Vector2f(0.f, difference.y < 0.f ? -1.f : 1.f);
+		penetrationDistance = overlapY;
+	}
+
+	sf::Vector2f resolveVectorLhs;
+	sf::Vector2f resolveVectorRhs;
+
+	if (lhs.isTriggerVolume || rhs.isTriggerVolume)
+	{
+		//Handle overlap
+	}
+	else if (!lhs.isTriggerVolume && !rhs.isTriggerVolume)
+	{
+		//Handle collision resolve
+		if (lhs.isStatic != rhs.isStatic)
+		{
+			CollisionEntry& movableEntry = lhs.isStatic ? rhs : lhs;
+			sf::Vector2f& resolveVector = lhs.isStatic ? resolveVectorRhs : resolveVectorLhs;
+			resolveVector = (lhs.isStatic ? -normal : normal) * penetrationDistance;
+
+			MoveOwner(movableEntry, movableEntry.position + resolveVector);
+		}
+		else if (!lhs.isStatic && !rhs.isStatic)
+		{
+			//Both movable move away from each other
+			resolveVectorLhs = normal * penetrationDistance * 0.5f;
+			resolveVectorRhs = normal * penetrationDistance * -0.5f;
+
+			MoveOwner(lhs, lhs.position + resolveVectorLhs);
+			MoveOwner(rhs, rhs.position + resolveVectorRhs);
+		}
+		else
+		{
+			//Both are static, do nothing (both immovable)
+		}
+	}
+
+	NotifyOverlap(lhs, rhs, resolveVectorLhs, resolveVectorRhs);
+}
+
+bool CollisionManager::HandleCollision_Swept(CollisionEntry& lhs, CollisionEntry& rhs)
+{
+	m_frameStats.narrowphaseTests++;
+
+	//shapes that are not swept hold still at their position. relative to rhs,
+	//lhs moves from origin by delta and the pair hits where that path first touches rhs grown by lhs
+	const sf::Vector2f lhsStart = lhs.isSwept ? lhs.previousPosition : lhs.position;
+	const sf::Vector2f rhsStart = rhs.isSwept ? rhs.previousPosition : rhs.position;
+	const sf::Vector2f lhsDelta = lhs.position - lhsStart;
+	const sf::Vector2f rhsDelta = rhs.position - rhsStart;
+
+	const sf::Vector2f origin = lhsStart - rhsStart;
+	const sf::Vector2f delta = lhsDelta - rhsDelta;
+
+	float fraction = FLT_MAX;
+	if (lhs.shape.type == EShapeType::Circle && rhs.shape.type == EShapeType::Circle)
+	{
+		const float center = 0.f;
+		const float radiusSum = lhs.shape.radius + rhs.shape.radius;
+		if (CollisionKernels::RaycastCircleBatch(origin.x, origin.y, delta.x, delta.y, &center, &center, &radiusSum, 1, fraction) == -1 || fraction > 1.f)
+			return true;
+	}
+	else
+	{
+		//only circles are swept, the path is the circle's relative to the box
+		const bool isLhsCircle = lhs.shape.type == EShapeType::Circle;
+		const CollisionShape& circle = isLhsCircle ? lhs.shape : rhs.shape;
+		const CollisionShape& box = isLhsCircle ? rhs.shape : lhs.shape;
+
+		if (!GetSweptCircleBoxFraction(isLhsCircle ? origin : -origin, isLhsCircle ? delta : -delta, circle.radius, sf::Vector2f(0.5f * box.width, 0.5f * box.height), fraction))
+			return true;
+	}
+
+	if (fraction <= 0.f)
+		return false;
+
+	sf::Vector2f resolveVectorLhs;
+	sf::Vector2f resolveVectorRhs;
+
+	if (lhs.isTriggerVolume || rhs.isTriggerVolume)
+	{
+		//Handle overlap
+	}
+	else
+	{
+		//swept sides stop at the time of impact, the others are not moved
+		if (lhs.isSwept)
+		{
+			resolveVectorLhs = lhsStart + lhsDelta * fraction - lhs.position;
+			MoveOwner(lhs, lhs.position + resolveVectorLhs);
+		}
+
+		if (rhs.isSwept)
+		{
+			resolveVectorRhs = rhsStart + rhsDelta * fraction - rhs.position;
+			MoveOwner(rhs, rhs.position + resolveVectorRhs);
+		}
+	}
+
+	NotifyOverlap(lhs, rhs, resolveVectorLhs, resolveVectorRhs);
+	return true;
+}
+
+bool CollisionManager::GetSweptCircleBoxFraction(sf::Vector2f origin, sf::Vector2f delta, float radius, sf::Vector2f halfExtents, float& outFraction)
+{
+	//the box grown by radius is the union of the box widened on each axis and the circles around its corners
+	const sf::Vector2f wideX = halfExtents + sf::Vector2f(radius, 0.f);
+	const sf::Vector2f wideY = halfExtents + sf::Vector2f(0.f, radius);
+	const CollisionAABB sides[2] = { { -wideX, wideX }, { -wideY, wideY } };
+
+	float fraction = 1.f;
+	bool isHit = false;
+
+	for (const CollisionAABB& side : sides)
+	{
+		float enter;
+		if (side.IntersectsSegment(origin, delta, fraction, enter) && enter <= fraction)
+		{
+			fraction = enter;
+			isHit = true;
+		}
+	}
+
+	const float cornerXs[4] = { -halfExtents.x, halfExtents.x, -halfExtents.x, halfExtents.x };
+	const float cornerYs[4] = { -halfExtents.y, -halfExtents.y, halfExtents.y, halfExtents.y };
+	const float radii[4] = { radius, radius, radius, radius };
+
+	float cornerFraction = fraction;
+	if (CollisionKernels::RaycastCircleBatch(origin.x, origin.y, delta.x, delta.y, cornerXs, cornerYs, radii, 4, cornerFraction) != -1)
+	{
+		fraction = cornerFraction;
+		isHit = true;
+	}
+
+	if (isHit)
+		outFraction = fraction;
+
+	return isHit;
+}
+
+void CollisionManager::EndSweeps()
+{
+	if (m_sweptShapeCount == 0)
+		return;
+
+	//the bounds only shrink here, the tree keeps the quarter until the next move
+	for (size_t i = 0; i < m_shapes_QT.size(); i++)
+	{
+		if (!m_shapes_QT[i].isSwept)
+			continue;
+
+		m_shapes_QT[i].previousPosition = m_shapes_QT[i].position;
+		m_QTSoA.Set(i, m_shapes_QT[i]);
+	}
+
+	for (CollisionEntry& entry : m_shapes_nonQT)
+	{
+		entry.previousPosition = entry.position;
+	}
+}
+
+sf::Vector2f CollisionManager::GetCircleBoxSolveDirection(sf::Vector2f difference) const
+{
+	static const std::array<sf::Vector2f, 4> dirs = {
+		sf::Vector2f(0.0f, 1.0f),	// up
+		sf::Vector2f(1.0f, 0.0f),	// right
+		sf::Vector2f(0.0f, -1.0f),	// down
+		sf::Vector2f(-1.0f, 0.0f)	// left
+	};
+
+	float max = 0.0f;
+	unsigned int bestMatch = -1;
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		float dot_product = sf::dot(sf::getNormalized(difference), dirs[i]);
+		if (dot_product > max)
+		{
+			max = dot_product;
+			bestMatch = i;
+		}
+	}
+
+	return dirs[bestMatch];
+}
+
+void CollisionEntrySoA::Push(const CollisionEntry& entry)
+{
+	x.emplace_back();
+	y.emplace_back();
+	radius.emplace_back();
+	flags.emplace_back();
+
+	Set(x.size() - 1, entry);
+}
+
+void CollisionEntrySoA::Set(size_t index, const CollisionEntry& entry)
+{
+	if (entry.isSwept)
+	{
+		//bounding circle of the path previousPosition -> position
+		const sf::Vector2f center = 0.5f * (entry.previousPosition + entry.position);
+		x[index] = center.x;
+		y[index] = center.y;
+		radius[index] = 0.5f * sf::getLength(entry.position - entry.previousPosition) + entry.shape.radius;
+	}
+	else
+	{
+		const CollisionAABB bounds = CollisionManager::GetEntryAABB(entry);
+
+		x[index] = entry.position.x;
+		y[index] = entry.position.y;
+		radius[index] = entry.shape.type == EShapeType::Circle ? entry.shape.radius : 0.5f * sf::getLength(bounds.max - bounds.min);
+	}
+
+	flags[index] = (entry.isDeleted ? COLLISION_FLAG_DELETED : 0) | (entry.isStatic ? COLLISION_FLAG_STATIC : 0) | (entry.isTriggerVolume ? COLLISION_FLAG_TRIGGER : 0) |
+		(entry.shape.type != EShapeType::Circle ? COLLISION_FLAG_BOX : 0) | (CollisionManager::IsIndexedByBounds(entry) ? COLLISION_FLAG_BOUNDS : 0) |
+		(entry.isSwept ? COLLISION_FLAG_SWEPT : 0);
+}
+
+void CollisionEntrySoA::RemoveAt(size_t index)
+{
+	const size_t last = x.size() - 1;
+	x[index] = x[last];
+	y[index] = y[last];
+	radius[index] = radius[last];
+	flags[index] = flags[last];
+
+	x.pop_back();
+	y.pop_back();
+	radius.pop_back();
+	flags.pop_back();
+}
+
+CollisionAABB CollisionManager::GetEntryAABB(const CollisionEntry& entry)
+{
+	const sf::Vector2f halfExtents = entry.shape.type == EShapeType::Circle ?
+		sf::Vector2f(entry.shape.radius, entry.shape.radius) :
+		sf::Vector2f(0.5f * entry.shape.width, 0.5f * entry.shape.height);
+
+	CollisionAABB bounds = { entry.position - halfExtents, entry.position + halfExtents };
+
+	//swept shapes cover their whole path of this Update
+	if (entry.isSwept)
+		bounds.Merge({ entry.previousPosition - halfExtents, entry.previousPosition + halfExtents });
+
+	return bounds;
+}
+
+template<typename TVisitor>
+void CollisionManager::ForEachStaticCandidate(const CollisionAABB& bounds, TVisitor&& visitor) const
+{
+	//shapes changed since the last build are not in the index yet
+	if (m_isStaticIndexDirty)
+	{
+		for (const CollisionEntry& entry : m_shapes_static)
+		{
+			visitor(entry);
+		}
+		return;
+	}
+
+	m_staticIndex->Query(bounds, [this, &visitor](int id) { visitor(m_shapes_static[m_slots[id & s_slotIndexMask].denseIndex]); });
+}
+
+float CollisionManager::GetEntryDistance(const CollisionEntry& entry, sf::Vector2f position)
+{
+	if (entry.shape.type == EShapeType::Circle)
+		return std::max(sf::getLength(position - entry.position) - entry.shape.radius, 0.f);
+
+	return GetEntryAABB(entry).GetDistance(position);
+}
+
+bool CollisionManager::IsEntryOverlapping(const CollisionEntry& entry, const CollisionAABB& bounds)
+{
+	if (entry.shape.type == EShapeType::Circle)
+		return bounds.GetDistance(entry.position) <= entry.shape.radius;
+
+	return bounds.Intersects(GetEntryAABB(entry));
+}
+
+int CollisionManager::QueryAABB(const CollisionAABB& bounds, int* outIds, int capacity) const
+{
+	RangeQuery query;
+	query.bounds = bounds;
+	query.outIds = outIds;
+	query.capacity = capacity;
+
+	QueryRange(query);
+	return query.count;
+}
+
+int CollisionManager::QueryRadius(sf::Vector2f center, float radius, int* outIds, int capacity) const
+{
+	RangeQuery query;
+	query.bounds = { center - sf::Vector2f(radius, radius), center + sf::Vector2f(radius, radius) };
+	query.center = center;
+	query.radius = std::max(radius, 0.f);
+	query.outIds = outIds;
+	query.capacity = capacity;
+
+	QueryRange(query);
+	return query.count;
+}
+
+void CollisionManager::QueryRange(RangeQuery& query) const
+{
+	//unindexed shapes are few, see ECollisionIndexPolicy
+	for (const CollisionEntry& entry : m_shapes_nonQT)
+	{
+		TestRangeQueryEntry(entry, query);
+	}
+
+	ForEachStaticCandidate(query.bounds, [this, &query](const CollisionEntry& entry) { TestRangeQueryEntry(entry, query); });
+
+	if (!IsUsingPointerQuadTree())
+	{
+		for (const CollisionEntry& entry : m_shapes_QT)
+		{
+			TestRangeQueryEntry(entry, query);
+		}
+		return;
+	}
+
+	QueryRange(m_quadtree->GetRootIndex(), query);
+}
+
+void CollisionManager::QueryRange(int QTNodeIndex, RangeQuery& query) const
+{
+	const QuadTreeNode& QTNode = m_quadtree->GetNode(QTNodeIndex);
+
+	for (int quarter = 0; quarter < 4; quarter++)
+	{
+		const bool overlapsCell = m_quadtree->GetQuarterReach(QTNode, quarter).Intersects(query.bounds);
+
+		//bounds indexed entries of the root may straddle its center (see QuadTree::FindQuarterForEntry)
+		if (overlapsCell || QTNodeIndex == m_quadtree->GetRootIndex())
+		{
+			for (int i = 0; i < QTNode.quaterEntryCount[quarter]; i++)
+			{
+				const int denseIndex = GetQTDenseIndex(m_quadtree->GetQuarterEntry(QTNode, quarter, i));
+				if (denseIndex != -1)
+					TestRangeQueryEntry(m_shapes_QT[denseIndex], query);
+			}
+		}
+
+		if (overlapsCell && QTNode.m_children[quarter] != -1)
+			QueryRange(QTNode.m_children[quarter], query);
+	}
+}
+
+void CollisionManager::TestRangeQueryEntry(const CollisionEntry& entry, RangeQuery& query) const
+{
+	if (entry.isDeleted)
+		return;
+
+	const bool isMatch = query.radius < 0.f ? IsEntryOverlapping(entry, query.bounds) : GetEntryDistance(entry, query.center) <= query.radius;
+	if (!isMatch)
+		return;
+
+	if (query.count < query.capacity)
+		query.outIds[query.count] = entry.id;
+
+	query.count++;
+}
+
+int CollisionManager::QueryKNearest(sf::Vector2f position, int k, int* outIds, float* outDistances, float maxDistance) const
+{
+	if (k <= 0)
+		return 0;
+
+	KNearestQuery query;
+	query.position = position;
+	query.k = k;
+	query.outIds = outIds;
+	query.outDistances = outDistances;
+	query.maxDistance = maxDistance;
+
+	for (const CollisionEntry& entry : m_shapes_nonQT)
+	{
+		TestKNearestEntry(entry, query);
+	}
+
+	if (IsUsingPointerQuadTree())
+	{
+		QueryKNearest(m_quadtree->GetRootIndex(), query);
+	}
+	else
+	{
+		for (const CollisionEntry& entry : m_shapes_QT)
+		{
+			TestKNearestEntry(entry, query);
+		}
+	}
+
+	//only what can beat the current search radius
+	const float searchRadius = query.GetSearchRadius();
+	const CollisionAABB searchBounds = { position - sf::Vector2f(searchRadius, searchRadius), position + sf::Vector2f(searchRadius, searchRadius) };
+	ForEachStaticCandidate(searchBounds, [this, &query](const CollisionEntry& entry) { TestKNearestEntry(entry, query); });
+
+	return query.count;
+}
+
+void CollisionManager::QueryKNearest(int QTNodeIndex, KNearestQuery& query) const
+{
+	const QuadTreeNode& QTNode = m_quadtree->GetNode(QTNodeIndex);
+	const bool isRoot = QTNodeIndex == m_quadtree->GetRootIndex();
+
+	//lower bound of the distance to anything stored in (or below) a quarter
+	std::array<float, 4> cellDistances;
+	for (int quarter = 0; quarter < 4; quarter++)
+	{
+		cellDistances[quarter] = m_quadtree->GetQuarterReach(QTNode, quarter).GetDistance(query.position);
+	}
+
+	//closest quarters first, so the search radius shrinks early and prunes the rest
+	std::array<int, 4> order = { 0, 1, 2, 3 };
+	std::sort(order.begin(), order.end(), [&cellDistances](int lhs, int rhs) { return cellDistances[lhs] < cellDistances[rhs]; });
+
+	for (int quarter : order)
+	{
+		//root entries may straddle its center, see QueryRange
+		if (isRoot || cellDistances[quarter] <= query.GetSearchRadius())
+		{
+			for (int i = 0; i < QTNode.quaterEntryCount[quarter]; i++)
+			{
+				const int denseIndex = GetQTDenseIndex(m_quadtree->GetQuarterEntry(QTNode, quarter, i));
+				if (denseIndex != -1)
+					TestKNearestEntry(m_shapes_QT[denseIndex], query);
+			}
+		}
+
+		if (QTNode.m_children[quarter] != -1 && cellDistances[quarter] <= query.GetSearchRadius())
+			QueryKNearest(QTNode.m_children[quarter], query);
+	}
+}
+
+void CollisionManager::TestKNearestEntry(const CollisionEntry& entry, KNearestQuery& query) const
+{
+	if (entry.isDeleted)
+		return;
+
+	const float distance = GetEntryDistance(entry, query.position);
+	if (distance > query.maxDistance || (query.count == query.k && distance >= query.outDistances[query.k - 1]))
+		return;
+
+	//insertion into the sorted results, the farthest one drops out once k are found
+	int i = query.count < query.k ? query.count++ : query.k - 1;
+	while (i > 0 && query.outDistances[i - 1] > distance)
+	{
+		query.outDistances[i] = query.outDistances[i - 1];
+		query.outIds[i] = query.outIds[i - 1];
+		i--;
+	}
+
+	query.outDistances[i] = distance;
+	query.outIds[i] = entry.id;
+}
+
+void CollisionManager::QueryAABBBatch(const CollisionAABB* bounds, int queryCount, int* outIds, int capacityPerQuery, int* outCounts)
+{
+	if (queryCount <= 0)
+		return;
+
+	AABBBatchQuery batch;
+	batch.bounds = bounds;
+	batch.outIds = outIds;
+	batch.capacityPerQuery = capacityPerQuery;
+	batch.outCounts = outCounts;
+
+	std::fill(outCounts, outCounts + queryCount, 0);
+
+	for (const CollisionEntry& entry : m_shapes_nonQT)
+	{
+		for (int query = 0; query < queryCount; query++)
+		{
+			TestAABBBatchEntry(entry, query, batch);
+		}
+	}
+
+	for (int query = 0; query < queryCount; query++)
+	{
+		ForEachStaticCandidate(bounds[query], [this, query, &batch](const CollisionEntry& entry) { TestAABBBatchEntry(entry, query, batch); });
+	}
+
+	if (!IsUsingPointerQuadTree())
+	{
+		for (const CollisionEntry& entry : m_shapes_QT)
+		{
+			for (int query = 0; query < queryCount; query++)
+			{
+				TestAABBBatchEntry(entry, query, batch);
+			}
+		}
+		return;
+	}
+
+	//the root level has every query active, deeper levels stack their subset behind it
+	m_batchQueryScratch.clear();
+	for (int query = 0; query < queryCount; query++)
+	{
+		m_batchQueryScratch.push_back(query);
+	}
 
-	const sf::Vector2f lhsToRhs = lhs.position - rhs.position;
-	const float distance = sf::getLength(lhsToRhs);
-	const float distanceBetweenCircles = distance - (lhsCircle.radius + rhsCircle.radius);
-	const sf::Vector2f normalizedLhsToRhs = sf::getNormalized(lhsToRhs);
+	QueryAABBBatch(m_quadtree->GetRootIndex(), 0, queryCount, batch);
+}
 
-	if (distanceBetweenCircles < 0.f)
+void CollisionManager::QueryAABBBatch(int QTNodeIndex, int activeBegin, int activeEnd, const AABBBatchQuery& batch)
+{
+	const QuadTreeNode& QTNode = m_quadtree->GetNode(QTNodeIndex);
+	const bool isRoot = QTNodeIndex == m_quadtree->GetRootIndex();
+
+	for (int quarter = 0; quarter < 4; quarter++)
 	{
-		sf::Vector2f resolveVectorLhs;
-		sf::Vector2f resolveVectorRhs;
+		//same test as QueryRange
+		const CollisionAABB reach = m_quadtree->GetQuarterReach(QTNode, quarter);
 
-		if (lhs.isTriggerVolume || rhs.isTriggerVolume)
+		//queries reaching into the quarter, [begin, end) of the scratch
+		const int begin = static_cast<int>(m_batchQueryScratch.size());
+		for (int i = activeBegin; i < activeEnd; i++)
 		{
-			//Handle overlap
+			const int query = m_batchQueryScratch[i];
+			if (reach.Intersects(batch.bounds[query]))
+				m_batchQueryScratch.push_back(query);
 		}
-		else if (!lhs.isTriggerVolume && !rhs.isTriggerVolume)
-		{
-			//Handle collision resolve
-			if (lhs.isStatic != rhs.isStatic)
-			{
-				CollisionEntry& movableEntry = lhs.isStatic ? rhs : lhs;
-				sf::Vector2f& resolveVector = lhs.isStatic ? resolveVectorRhs : resolveVectorLhs;
-				resolveVector = (lhs.isStatic ? normalizedLhsToRhs : -normalizedLhsToRhs) * distanceBetweenCircles;
+		const int end = static_cast<int>(m_batchQueryScratch.size());
 
-				movableEntry.pEntity->SetPosition(movableEntry.position + resolveVector);
-			}
-			else if (!lhs.isStatic && !rhs.isStatic)
+		//root entries may straddle its center, they are tested against every query
+		const int testBegin = isRoot ? activeBegin : begin;
+		const int testEnd = isRoot ? activeEnd : end;
+		if (testBegin != testEnd)
+		{
+			for (int i = 0; i < QTNode.quaterEntryCount[quarter]; i++)
 			{
-				//Both movable move away from each other
-				resolveVectorLhs = normalizedLhsToRhs * distanceBetweenCircles * -0.5f;
-				resolveVectorRhs = normalizedLhsToRhs * distanceBetweenCircles * 0.5f;
+				const int denseIndex = GetQTDenseIndex(m_quadtree->GetQuarterEntry(QTNode, quarter, i));
+				if (denseIndex == -1)
+					continue;
 
-				lhs.pEntity->SetPosition(lhs.position + resolveVectorLhs);
-				rhs.pEntity->SetPosition(rhs.position + resolveVectorRhs);
-			}
-			else
-			{
-				//Both are static, do nothing (both immovable)
+				for (int k = testBegin; k < testEnd; k++)
+				{
+					TestAABBBatchEntry(m_shapes_QT[denseIndex], m_batchQueryScratch[k], batch);
+				}
 			}
 		}
 
-		if (lhs.callback)
-			lhs.callback(lhs, rhs, resolveVectorLhs);
+		if (begin != end && QTNode.m_children[quarter] != -1)
+			QueryAABBBatch(QTNode.m_children[quarter], begin, end, batch);
 
-		if (rhs.callback)
-			rhs.callback(rhs, lhs, resolveVectorRhs);
+		m_batchQueryScratch.resize(begin);
 	}
 }
 
-void CollisionManager::HandleCollision_Circle_Box(CollisionEntry& lhs, CollisionEntry& rhs)
+void CollisionManager::TestAABBBatchEntry(const CollisionEntry& entry, int query, const AABBBatchQuery& batch) const
 {
-	CollisionShape& lhsCircle = lhs.shape;
-	CollisionShape& rhsBox = rhs.shape;
+	if (entry.isDeleted || !IsEntryOverlapping(entry, batch.bounds[query]))
+		return;
 
-	// get center point circle first 
-	// calculate AABB info (center, half-extents)
-	sf::Vector2f aabb_half_extents(rhsBox.width * 0.5f, rhsBox.height * 0.5f);
-	// get difference vector between both centers
-	sf::Vector2f difference = lhs.position - rhs.position;
+	int& count = batch.outCounts[query];
+	if (count < batch.capacityPerQuery)
+		batch.outIds[query * batch.capacityPerQuery + count] = entry.id;
 
-	sf::Vector2f clamped;
-	clamped.x = std::clamp(difference.x, -aabb_half_extents.x, aabb_half_extents.x);
-	clamped.y = std::clamp(difference.y, -aabb_half_extents.y, aabb_half_extents.y);
+	count++;
+}
 
-	// now that we know the clamped values, add this to AABB_center and we get the value of box closest to circle
-	sf::Vector2f closest = rhs.position + clamped;
+float CollisionManager::GetEntryRayFraction(const CollisionEntry& entry, sf::Vector2f origin, sf::Vector2f delta)
+{
+	if (entry.shape.type == EShapeType::Circle)
+	{
+		float fraction = FLT_MAX;
+		const bool isHit = CollisionKernels::RaycastCircleBatch(origin.x, origin.y, delta.x, delta.y, &entry.position.x, &entry.position.y, &entry.shape.radius, 1, fraction) != -1;
+		return isHit && fraction <= 1.f ? fraction : -1.f;
+	}
 
-	// now retrieve vector between center circle and closest point AABB and check if length < radius
-	difference = closest - lhs.position;
+	float enter;
+	return GetEntryAABB(entry).IntersectsSegment(origin, delta, 1.f, enter) ? enter : -1.f;
+}
 
-	if (difference.x == 0.f && difference.y == 0.f)
+void CollisionManager::RaycastBatch(const CollisionRay* rays, int rayCount, CollisionRayHit* outHits)
+{
+	//the tree and the shapes are only read, every ray writes its own hit
+	if (m_jobSystem)
+	{
+		m_jobSystem->ParallelFor(rayCount, [&](int rayIndex, int workerIndex)
+		{
+			CastRay(rays[rayIndex], outHits[rayIndex], m_workerContexts[workerIndex].circleBatch);
+		});
 		return;
+	}
 
-	const float diffLength = sf::getLength(difference);
+	for (int i = 0; i < rayCount; i++)
+	{
+		CastRay(rays[i], outHits[i], m_rayCircleBatch);
+	}
+}
 
-	if (diffLength < lhsCircle.radius)
+bool CollisionManager::Raycast(const CollisionRay& ray, CollisionRayHit& outHit)
+{
+	CastRay(ray, outHit, m_rayCircleBatch);
+	return outHit.id != 0;
+}
+
+void CollisionManager::CastRay(const CollisionRay& ray, CollisionRayHit& outHit, CollisionCircleBatch& batch) const
+{
+	RayCast cast;
+	cast.origin = ray.origin;
+	cast.delta = ray.end - ray.origin;
+	cast.ignoreId = ray.ignoreId;
+
+	for (const CollisionEntry& entry : m_shapes_nonQT)
 	{
-		const float penetrationDistance = lhsCircle.radius - diffLength;
+		TestRayEntry(entry, cast);
+	}
 
-		sf::Vector2f resolveVectorLhs;
-		sf::Vector2f resolveVectorRhs;
+	if (m_isStaticIndexDirty)
+	{
+		for (const CollisionEntry& entry : m_shapes_static)
+		{
+			TestRayEntry(entry, cast);
+		}
+	}
+	else
+	{
+		//cast.fraction shrinks with every hit, the index walk skips whatever lies behind it
+		m_staticIndex->QuerySegment(cast.origin, cast.delta, cast.fraction, [this, &cast](int id)
+		{
+			TestRayEntry(m_shapes_static[m_slots[id & s_slotIndexMask].denseIndex], cast);
+		});
+	}
 
-		if (lhs.isTriggerVolume || rhs.isTriggerVolume)
+	if (IsUsingPointerQuadTree())
+	{
+		CastRay(m_quadtree->GetRootIndex(), cast, batch);
+	}
+	else
+	{
+		for (const CollisionEntry& entry : m_shapes_QT)
 		{
-			//Handle overlap
+			TestRayEntry(entry, cast);
 		}
-		else if (!lhs.isTriggerVolume && !rhs.isTriggerVolume)
+	}
+
+	outHit = CollisionRayHit();
+	outHit.fraction = cast.fraction;
+	outHit.point = cast.origin + cast.delta * cast.fraction;
+
+	if (cast.hitId == 0)
+		return;
+
+	outHit.id = cast.hitId;
+
+	const CollisionEntrySlot& slot = m_slots[cast.hitId & s_slotIndexMask];
+	const CollisionEntry& entry = slot.isQTEntry ? m_shapes_QT[slot.denseIndex] : (slot.isStaticEntry ? m_shapes_static[slot.denseIndex] : m_shapes_nonQT[slot.denseIndex]);
+
+	if (cast.fraction == 0.f)
+	{
+		//started inside, there is no surface to take the normal from
+		if (cast.delta != sf::Vector2f())
+			outHit.normal = -sf::getNormalized(cast.delta);
+	}
+	else if (entry.shape.type == EShapeType::Circle)
+	{
+		outHit.normal = sf::getNormalized(outHit.point - entry.position);
+	}
+	else
+	{
+		//the face the point lies on
+		const CollisionAABB bounds = GetEntryAABB(entry);
+		const std::array<float, 4> faceDistances = { std::abs(outHit.point.x - bounds.min.x), std::abs(outHit.point.x - bounds.max.x),
+			std::abs(outHit.point.y - bounds.min.y), std::abs(outHit.point.y - bounds.max.y) };
+		const std::array<sf::Vector2f, 4> faceNormals = { sf::Vector2f(-1.f, 0.f), sf::Vector2f(1.f, 0.f), sf::Vector2f(0.f, -1.f), sf::Vector2f(0.f, 1.f) };
+
+		outHit.normal = faceNormals[std::min_element(faceDistances.begin(), faceDistances.end()) - faceDistances.begin()];
+	}
+}
+
+void CollisionManager::CastRay(int QTNodeIndex, RayCast& cast, CollisionCircleBatch& batch) const
+{
+	const QuadTreeNode& QTNode = m_quadtree->GetNode(QTNodeIndex);
+	const bool isRoot = QTNodeIndex == m_quadtree->GetRootIndex();
+
+	//root entries may straddle its center, they are tested before walking its quarters
+	if (isRoot)
+	{
+		for (int quarter = 0; quarter < 4; quarter++)
 		{
-			//Handle collision resolve
-			if (lhs.isStatic != rhs.isStatic)
-			{
-				//Both movable move away from each other
-				sf::Vector2f& resolveVector = lhs.isStatic ? resolveVectorRhs : resolveVectorLhs;
-				CollisionEntry& movableEntry = lhs.isStatic ? rhs : lhs;
-				resolveVector = GetCircleBoxSolveDirection(difference) * penetrationDistance;
+			CastRayThroughQuarter(QTNode, quarter, cast, batch);
+		}
+	}
 
-				movableEntry.pEntity->SetPosition(movableEntry.position - resolveVector);
-			}
-			else if (!lhs.isStatic && !rhs.isStatic)
-			{
-				//Both movable move away from each other
-				sf::Vector2f solveDirection = GetCircleBoxSolveDirection(difference);
+	//quarters whose reach the segment passes through (like in QueryRange), ordered by where it enters them
+	std::array<float, 4> enter;
+	std::array<int, 4> order;
+	int count = 0;
+	for (int quarter = 0; quarter < 4; quarter++)
+	{
+		if (m_quadtree->GetQuarterReach(QTNode, quarter).IntersectsSegment(cast.origin, cast.delta, cast.fraction, enter[quarter]))
+			order[count++] = quarter;
+	}
+	std::sort(order.begin(), order.begin() + count, [&enter](int lhs, int rhs) { return enter[lhs] < enter[rhs]; });
 
-				resolveVectorLhs = solveDirection * penetrationDistance * -0.5f;
-				resolveVectorRhs = solveDirection * penetrationDistance * 0.5f;
+	for (int i = 0; i < count; i++)
+	{
+		const int quarter = order[i];
 
-				lhs.pEntity->SetPosition(lhs.position + resolveVectorLhs);
-				rhs.pEntity->SetPosition(rhs.position + resolveVectorRhs);
-			}
-			else
-			{
-				//Both are static, do nothing (both immovable)
-			}
+		//this quarter and the ones behind it start past the nearest hit
+		if (enter[quarter] >= cast.fraction)
+			break;
+
+		if (!isRoot)
+			CastRayThroughQuarter(QTNode, quarter, cast, batch);
+
+		if (QTNode.m_children[quarter] != -1)
+			CastRay(QTNode.m_children[quarter], cast, batch);
+	}
+}
+
+void CollisionManager::CastRayThroughQuarter(const QuadTreeNode& QTNode, int quarter, RayCast& cast, CollisionCircleBatch& batch) const
+{
+	batch.Clear();
+	for (int i = 0; i < QTNode.quaterEntryCount[quarter]; i++)
+	{
+		const int id = m_quadtree->GetQuarterEntry(QTNode, quarter, i);
+		const int denseIndex = GetQTDenseIndex(id);
+
+		if (denseIndex == -1 || id == cast.ignoreId || (m_QTSoA.flags[denseIndex] & COLLISION_FLAG_DELETED))
+			continue;
+
+		//the SoA only has the bounding radius of boxes and swept paths
+		if (m_QTSoA.flags[denseIndex] & COLLISION_FLAGS_SHAPE_TEST)
+		{
+			TestRayEntry(m_shapes_QT[denseIndex], cast);
+			continue;
 		}
 
-		if (lhs.callback)
-			lhs.callback(lhs, rhs, resolveVectorLhs);
+		batch.Push(id, m_QTSoA.x[denseIndex], m_QTSoA.y[denseIndex], m_QTSoA.radius[denseIndex]);
+	}
+
+	const int nearest = CollisionKernels::RaycastCircleBatch(cast.origin.x, cast.origin.y, cast.delta.x, cast.delta.y,
+		batch.x.data(), batch.y.data(), batch.radius.data(), batch.Size(), cast.fraction);
 
-		if (rhs.callback)
-			rhs.callback(rhs, lhs, resolveVectorRhs);
+	if (nearest != -1)
+		cast.hitId = batch.ids[nearest];
+}
+
+void CollisionManager::TestRayEntry(const CollisionEntry& entry, RayCast& cast) const
+{
+	if (entry.isDeleted || entry.id == cast.ignoreId)
+		return;
+
+	const float fraction = GetEntryRayFraction(entry, cast.origin, cast.delta);
+	if (fraction >= 0.f && fraction < cast.fraction)
+	{
+		cast.fraction = fraction;
+		cast.hitId = entry.id;
 	}
 }
 
-void CollisionManager::HandleCollision_Box_Box(CollisionEntry& lhs, CollisionEntry& rhs)
+void CollisionManager::SetCollisionEvents(int id, uint8_t eventMask, const TCollisionEventSignature& callback)
+{
+	if (m_isDispatchingCallbacks)
+	{
+		m_pendingCollisionEvents.push_back({ id, eventMask, callback });
+		return;
+	}
+
+	size_t outEntryIndex = 0;
+	bool isQTEntry;
+	if (CollisionEntry* pEntry = FindCollisionEntryById(id, outEntryIndex, isQTEntry))
+	{
+		pEntry->eventMask = callback ? eventMask : 0;
+		m_entryCallbacks[id & s_slotIndexMask].eventCallback = callback;
+	}
+}
+
+void CollisionManager::NotifyOverlap(CollisionEntry& lhs, CollisionEntry& rhs, sf::Vector2f resolveVectorLhs, sf::Vector2f resolveVectorRhs)
 {
-	// to be implemented
+	if (lhs.eventMask | rhs.eventMask)
+		m_pairKeys.push_back(MakePairKey(lhs.id, rhs.id));
+
+	//no callbacks from inside the detection loop, see DispatchContactCallbacks
+	CollisionContactRecord& record = m_contactRecords.emplace_back();
+	record.lhsId = lhs.id;
+	record.rhsId = rhs.id;
+	record.pLhsEntity = lhs.pEntity;
+	record.pRhsEntity = rhs.pEntity;
+	record.resolveVectorLhs = resolveVectorLhs;
+	record.resolveVectorRhs = resolveVectorRhs;
 }
 
-sf::Vector2f CollisionManager::GetCircleBoxSolveDirection(sf::Vector2f difference) const
+void CollisionManager::DispatchContactCallbacks()
 {
-	static const std::array<sf::Vector2f, 4> dirs = {
-		sf::Vector2f(0.0f, 1.0f),	// up
-		sf::Vector2f(1.0f, 0.0f),	// right
-		sf::Vector2f(0.0f, -1.0f),	// down
-		sf::Vector2f(-1.0f, 0.0f)	// left
-	};
+	COLLISION_PROFILE_ZONE("CollisionManager::DispatchContactCallbacks");
 
-	float max = 0.0f;
-	unsigned int bestMatch = -1;
-	for (unsigned int i = 0; i < 4; i++)
+	//compatibility path for the per shape callbacks, nothing to do unless a shape registered one
+	if (m_callbackShapeCount == 0)
+		return;
+
+	BeginCallbackDispatch();
+	for (size_t i = 0; i < m_contactRecords.size(); i++)
 	{
-		float dot_product = sf::dot(sf::getNormalized(difference), dirs[i]);
-		if (dot_product > max)
+		const CollisionContactRecord& record = m_contactRecords[i];
+
+		//looked up again for every call, a callback may unregister either side or register shapes and move the entries
+		for (int side = 0; side < 2; side++)
 		{
-			max = dot_product;
-			bestMatch = i;
+			size_t x;
+			bool isQTEntry;
+
+			const int selfId = side == 0 ? record.lhsId : record.rhsId;
+			const int otherId = side == 0 ? record.rhsId : record.lhsId;
+
+			const CollisionEntry* self = FindCollisionEntryById(selfId, x, isQTEntry);
+			const CollisionEntry* other = FindCollisionEntryById(otherId, x, isQTEntry);
+			if (self == nullptr || self->isDeleted || other == nullptr || other->isDeleted)
+				break;
+
+			if (!self->hasCallback)
+				continue;
+
+			m_entryCallbacks[selfId & s_slotIndexMask].callback(*self, *other, side == 0 ? record.resolveVectorLhs : record.resolveVectorRhs);
 		}
 	}
+	EndCallbackDispatch();
+}
 
-	return dirs[bestMatch];
+void CollisionManager::BeginCallbackDispatch()
+{
+	assert(!m_isDispatchingCallbacks);
+	m_isDispatchingCallbacks = true;
 }
 
-CollisionEntry* CollisionManager::FindCollisionEntryById(int id, size_t& outIndex, bool& outIsQTEntry)
+void CollisionManager::EndCallbackDispatch()
 {
-	for (int i = 0; i < m_shapes_QT.size(); i++)
+	m_isDispatchingCallbacks = false;
+
+	//slots released by the callbacks, nothing of theirs runs anymore
+	for (int slotIndex : m_pendingFreeSlots)
 	{
-		if (m_shapes_QT[i].id == id)
-		{
-			outIndex = i;
-			outIsQTEntry = true;
-			return &m_shapes_QT[i];
-		}
+		m_entryCallbacks[slotIndex] = CollisionEntryCallbacks();
+		m_slots[slotIndex].nextFreeSlot = m_freeSlotHead;
+		m_freeSlotHead = slotIndex;
+	}
+	m_pendingFreeSlots.clear();
+
+	//in call order, ids removed in the meantime are ignored
+	for (const PendingCollisionEvents& pending : m_pendingCollisionEvents)
+	{
+		SetCollisionEvents(pending.id, pending.eventMask, pending.callback);
 	}
+	m_pendingCollisionEvents.clear();
+}
+
+uint64_t CollisionManager::MakePairKey(int lhsId, int rhsId)
+{
+	return (static_cast<uint64_t>(std::min(lhsId, rhsId)) << 32) | static_cast<uint32_t>(std::max(lhsId, rhsId));
+}
 
-	for (int i = 0; i < m_shapes_nonQT.size(); i++)
+void CollisionManager::DispatchCollisionEvents()
+{
+	//the detection reports every pair once, sorted for the merge with the previous Update
+	std::sort(m_pairKeys.begin(), m_pairKeys.end());
+	assert(std::adjacent_find(m_pairKeys.begin(), m_pairKeys.end()) == m_pairKeys.end());
+
+	//merge of the two sorted caches: only in this Update enters, in both stays, only in the previous one exits
+	BeginCallbackDispatch();
+	size_t current = 0;
+	size_t previous = 0;
+	while (current < m_pairKeys.size() || previous < m_previousPairKeys.size())
 	{
-		if (m_shapes_nonQT[i].id == id)
+		ECollisionEventType type;
+		uint64_t key;
+
+		if (previous == m_previousPairKeys.size() || (current < m_pairKeys.size() && m_pairKeys[current] < m_previousPairKeys[previous]))
+		{
+			type = ECollisionEventType::Enter;
+			key = m_pairKeys[current++];
+		}
+		else if (current == m_pairKeys.size() || m_previousPairKeys[previous] < m_pairKeys[current])
 		{
-			outIndex = i;
-			outIsQTEntry = false;
-			return &m_shapes_nonQT[i];
+			type = ECollisionEventType::Exit;
+			key = m_previousPairKeys[previous++];
 		}
+		else
+		{
+			type = ECollisionEventType::Stay;
+			key = m_pairKeys[current++];
+			previous++;
+		}
+
+		const int lowerId = static_cast<int>(key >> 32);
+		const int higherId = static_cast<int>(key & 0xffffffffu);
+		DispatchCollisionEvent(type, lowerId, higherId);
+		DispatchCollisionEvent(type, higherId, lowerId);
+	}
+	EndCallbackDispatch();
+
+	//the buffers swap roles, their capacity is kept
+	std::swap(m_pairKeys, m_previousPairKeys);
+	m_pairKeys.clear();
+}
+
+void CollisionManager::DispatchCollisionEvent(ECollisionEventType type, int selfId, int otherId)
+{
+	size_t x;
+	bool isQTEntry;
+
+	//removed shapes get no events, their partners still get the exit
+	CollisionEntry* self = FindCollisionEntryById(selfId, x, isQTEntry);
+	if (self == nullptr || self->isDeleted || !(self->eventMask & (1 << static_cast<int>(type))))
+		return;
+
+	m_entryCallbacks[selfId & s_slotIndexMask].eventCallback(type, selfId, otherId);
+}
+
+void CollisionManager::MoveOwner(CollisionEntry& entry, sf::Vector2f position)
+{
+	if (m_ownerMoveCallback && entry.pEntity)
+		m_ownerMoveCallback(entry.pEntity, position);
+	else
+		UpdateShapePosition(entry.id, position);
+}
+
+CollisionEntry* CollisionManager::FindCollisionEntryById(int id, size_t& outIndex, bool& outIsQTEntry)
+{
+	m_frameStats.entryLookups++;
+
+	if (!IsValidId(id))
+		return nullptr;
+
+	const CollisionEntrySlot& slot = m_slots[id & s_slotIndexMask];
+	outIndex = slot.denseIndex;
+	outIsQTEntry = slot.isQTEntry;
+
+	if (slot.isQTEntry)
+		return &m_shapes_QT[slot.denseIndex];
+
+	return slot.isStaticEntry ? &m_shapes_static[slot.denseIndex] : &m_shapes_nonQT[slot.denseIndex];
+}
+
+bool CollisionManager::IsValidId(int id) const
+{
+	if (id <= 0)
+		return false;
+
+	const size_t slotIndex = static_cast<size_t>(id & s_slotIndexMask);
+	if (slotIndex >= m_slots.size())
+		return false;
+
+	const CollisionEntrySlot& slot = m_slots[slotIndex];
+	return slot.denseIndex != -1 && slot.generation == (id >> s_slotIndexBits);
+}
+
+int CollisionManager::AllocateSlot(bool isQTEntry, bool isStaticEntry, size_t denseIndex)
+{
+	int slotIndex = m_freeSlotHead;
+	if (slotIndex != -1)
+	{
+		m_freeSlotHead = m_slots[slotIndex].nextFreeSlot;
+	}
+	else
+	{
+		slotIndex = static_cast<int>(m_slots.size());
+		assert(slotIndex <= s_slotIndexMask);
+		m_slots.emplace_back();
+		m_entryCallbacks.emplace_back();
+	}
+
+	CollisionEntrySlot& slot = m_slots[slotIndex];
+	slot.denseIndex = static_cast<int>(denseIndex);
+	slot.nextFreeSlot = -1;
+	slot.isQTEntry = isQTEntry;
+	slot.isStaticEntry = isStaticEntry;
+
+	return (slot.generation << s_slotIndexBits) | slotIndex;
+}
+
+void CollisionManager::RemoveEntryAt(std::vector<CollisionEntry>& shapes, size_t index)
+{
+	//release the slot; bumping the generation invalidates every copy of the old id
+	const int slotIndex = shapes[index].id & s_slotIndexMask;
+	CollisionEntrySlot& slot = m_slots[slotIndex];
+	slot.denseIndex = -1;
+	slot.generation = slot.generation < s_maxSlotGeneration ? slot.generation + 1 : 1;
+
+	//the slot's callback may be the one running, it is cleared and reused after the dispatch
+	if (m_isDispatchingCallbacks)
+	{
+		m_pendingFreeSlots.push_back(slotIndex);
+	}
+	else
+	{
+		m_entryCallbacks[slotIndex] = CollisionEntryCallbacks();
+		slot.nextFreeSlot = m_freeSlotHead;
+		m_freeSlotHead = slotIndex;
 	}
 
-	return nullptr;
+	if (shapes[index].hasCallback)
+		m_callbackShapeCount--;
+	if (shapes[index].isSwept)
+		m_sweptShapeCount--;
+
+	if (&shapes == &m_shapes_QT)
+		m_QTSoA.RemoveAt(index);
+
+	//swap-and-pop, then patch the moved entry's slot
+	if (index != shapes.size() - 1)
+	{
+		shapes[index] = std::move(shapes.back());
+		m_slots[shapes[index].id & s_slotIndexMask].denseIndex = static_cast<int>(index);
+	}
+	shapes.pop_back();
 }
@@ -1,99 +1,131 @@
 #pragma once
 
-#include "Engine/Engine.h"
-#include "Engine/Rendering/RenderSystem.h"
-#include "Engine/EntitySystem/EntitySystem.h"
-#include "Engine/EntitySystem/Components/TextRenderComponent.h"
-#include "Engine/Input/InputManager.h"
+//spatial core (QuadTree, QuadTreeNode, CollisionManager) - no Engine, window or entity system dependency.
+//the debug visualization lives in CollisionDebugOverlay and only attaches through ICollisionDebugLayer
 
-#include <SFML/Graphics.hpp>
+#include "CollisionTypes.h"
+#include "CollisionKernels.h"
+#include "CollisionStats.h"
+
+#include <SFML/System/Vector2.hpp>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <vector>
 
-struct CollisionEntry;
 class Entity;
 class QuadTreeNode;
-
-using TCollisionCallbackSignature = std::function<void(const CollisionEntry&, const CollisionEntry&, sf::Vector2f)>;
-
-enum class EShapeType
+class QuadTree;
+class BroadphaseBackend;
+class LinearQuadTree;
+class SpatialHashGrid;
+class SweepAndPrune;
+class StaticCollisionIndex;
+class CollisionJobSystem;
+class CollisionReplayRecorder;
+class CollisionManager;
+
+using TOwnerMoveSignature = std::function<void(Entity*, sf::Vector2f)>;
+using TContactHandlerSignature = std::function<void(const std::vector<CollisionContactRecord>&)>;
+
+//Strict: pairs of center indexed entries are only generated inside one leaf quarter,
+//        bounds indexed entries (see ECollisionIndexPolicy) query the tree for their pairs.
+//        lossy: two center indexed shapes overlapping across a quarter border are never paired
+//Loose: every quarter carries the bounds of the shapes below it, pairs are also generated
+//       against neighbouring quarters those bounds overlap, so straddling shapes are found.
+//       the default, it finds every pair brute force finds
+enum class EQuadTreeBoundsMode
 {
-	Circle,
-	Box
+	Strict,
+	Loose
 };
 
-struct CollisionShape
+//QuadTree: pointer based tree, updated incrementally on every UpdateShapePosition
+//LinearQuadTree: Morton ordered tree rebuilt from the SoA every Update, pairs with loose semantics
+//HashGrid: uniform spatial hash grid rebuilt from the SoA every Update, for evenly spread shapes of similar size
+//SweepAndPrune: x sorted list kept between Updates and insertion sorted, for moderate counts with coherent motion
+enum class EBroadphaseBackend
 {
-	EShapeType type = EShapeType::Circle;
-	float radius = 0.f;
-	float width = 0.f;
-	float height = 0.f;
+	QuadTree,
+	LinearQuadTree,
+	HashGrid,
+	SweepAndPrune
 };
 
-struct CollisionEntry
+//optional observer for debug visualization / tooling, the core runs without one
+class ICollisionDebugLayer
 {
-	int id = 0;
-	bool registeredForQTEntry = false;
-	bool isDeleted = false;
-	bool isStatic = false;
-
-	sf::Vector2f position;
-	CollisionShape shape;
+public:
+	virtual ~ICollisionDebugLayer() = default;
 
-	bool isTriggerVolume = true;
-	TCollisionCallbackSignature callback;
+	virtual void OnQTNodeCreated(const QuadTreeNode& /*node*/) {}
+	virtual void OnQTNodeDestroyed(const QuadTreeNode& /*node*/) {}
+	virtual void OnQTQuarterCountChanged(const QuadTreeNode& /*node*/, int /*quarter*/) {}
+	virtual void OnBulletCountChanged(int /*bulletCount*/) {}
+};
 
-	QuadTreeNode* QTNode = nullptr;
-	int QTNodeQuater = 0;
+//inline entry slots per quarter; a quarter that can not be subdivided any further
+//spills the remaining entries into a pooled overflow bucket owned by the QuadTree
+constexpr int QUADTREE_QUARTER_SLOTS = 8;
 
-	Entity* pEntity = nullptr;
+//QuadTree layout, tunable per map (see CollisionManager::SetQuadTreeConfig)
+struct QuadTreeConfig
+{
+	//the root covers this area at first, entries outside of it are clamped into the border quarters until the root grows
+	CollisionAABB worldBounds = { sf::Vector2f(-640.f, -360.f), sf::Vector2f(640.f, 360.f) };
+	//times the root may double to take in entries outside of it (see QuadTree::GetConfig), 0 keeps the root fixed.
+	//the old root becomes a quarter of the new one, so the cost per entry stays logarithmic wherever entries go
+	int maxRootGrowth = 12;
+	//a quarter holding more entries is subdivided, < QUADTREE_QUARTER_SLOTS so a split quarter still fits inline
+	int leafCapacity = 2;
+	//a leaf node holding this many entries or fewer is merged back into its parent. below leafCapacity,
+	//so a shape moving back and forth over a quarter border does not split and merge the node every frame
+	int mergeCapacity = 1;
+	//no subdivision into quarters whose longer side is below this (should be >= 2x the typical bullet radius)
+	float minCellExtent = 20.f;
+	//levels below the root
+	int maxDepth = 16;
+};
 
+//structural work of the QuadTree since the last QuadTree::ResetStats, see CollisionFrameStats
+struct QuadTreeStats
+{
+	long long nodeVisits = 0;
+	int subdivisions = 0;
+	int merges = 0;
+	long long reinsertions = 0;
 };
 
+//quarters: 0 = nw, 1 = ne, 2 = se, 3 = sw
 class QuadTreeNode
 {
 public:
-	QuadTreeNode(sf::Vector2f centerOffset, sf::Vector2u size, int id, int parentQuarter, int maxQuarterEntries) 
-: m_centerOffset(centerOffset), m_size(size), m_id(id), m_parentQuarter(parentQuarter), m_maxQuarterEntries(maxQuarterEntries)
-	{
-		Init();
-	};
-	void Init();
-
-	~QuadTreeNode()
-	{
-		Engine::GetInstance()->GetRenderSystem().RemoveLine(m_renderIndexHorizontal);
-		Engine::GetInstance()->GetRenderSystem().RemoveLine(m_renderIndexVertical);
-
-		for (int i = 0; i < 4; i++)
-		{
-			m_TextEntities[i]->Destroy();
-		}
-	};
+	void Init(sf::Vector2f centerOffset, sf::Vector2u size, int id, int parent, int parentQuarter);
 
-	sf::Vector2u GetSize() { return m_size; }
-   	sf::Vector2f GetCenterOffset() { return m_centerOffset; }
-	bool IsDestroyed() { return m_isDestroyed; }
-	void Destroy() { m_isDestroyed = true; m_parent = nullptr;  }
+	sf::Vector2u GetSize() const { return m_size; }
+   	sf::Vector2f GetCenterOffset() const { return m_centerOffset; }
+	bool IsDestroyed() const { return m_isDestroyed; }
+	void Destroy() { m_isDestroyed = true; m_parent = -1;  }
+	bool HasChildren() const { return m_children[0] != -1 || m_children[1] != -1 || m_children[2] != -1 || m_children[3] != -1; }
 
-	struct QuadTreeNode* m_parent = nullptr;
+	int m_index = -1;
+	int m_parent = -1;
 	int m_parentID = 0;
-	QuadTreeNode* m_nw = nullptr;
-	QuadTreeNode* m_ne = nullptr;
-	QuadTreeNode* m_se = nullptr;
-	QuadTreeNode* m_sw = nullptr;
-
-	Entity* m_TextEntities[4];
-	TextRenderComponent* m_TextCountEntitiesComponents[4];
-	std::vector<int> m_quaterEntryIDs[4];
+	int m_children[4] = { -1, -1, -1, -1 };
+	CollisionAABB m_region; //positions routed into this node by QuadTree::GetQuarter, min exclusive / max inclusive
+
+	int m_quaterEntryIDs[4][QUADTREE_QUARTER_SLOTS];
+	CollisionAABB m_quarterBounds[4]; //loose bounds, see QuadTree::RefitLooseBounds
 	int quaterEntryCount[4] = {0,0,0,0};
+	int m_overflowBucket[4] = { -1, -1, -1, -1 };
 	int m_parentQuarter = -1;
-	int m_id;
+	int m_depth = 0;
+	int m_id = 0;
+	int m_nextFreeNode = -1;
+	bool m_isRestructuringQueued = false;
 
 private:
-	bool m_isDestroyed = false;
-	int m_renderIndexHorizontal = 0;
-	int m_renderIndexVertical = 0;
-	const int m_maxQuarterEntries;
+	bool m_isDestroyed = true;
 	sf::Vector2f m_centerOffset;
 	sf::Vector2u m_size;
 };
@@ -101,87 +133,465 @@ private:
 class QuadTree
 {
 public:
-	void Init(CollisionManager* manager);
-	~QuadTree()
-	{
-		Engine::GetInstance()->GetInputManager().Unregister(m_inputCallbackId);
-		delete m_quadTreeRoot;
-	}
-
-	QuadTreeNode* AddQTEntry(CollisionEntry* entry);
-	void RemoveQTEntry(CollisionEntry* entry, QuadTreeNode* m_quadtree, int quarter, bool isSubdivision);
-	QuadTreeNode* SubdivideQTQuarter(QuadTreeNode* currentQuadtree, int quarter);
-	QuadTreeNode* UpdateQTEntryAttributes(CollisionEntry* entry);
-
-	QuadTreeNode* GetRootNode() { return m_quadTreeRoot;  }
-	QuadTreeNode* FindQTByID(QuadTreeNode* root, int id);
-	const int& MaxEntriesPerQuarter() { return m_maxQuarterEntries; }
-
-	void OnInputPressed();
+	void Init(CollisionManager* manager, const QuadTreeConfig& config);
+	~QuadTree();
+
+	//drops every entry and rebuilds the root from the new world bounds, the caller re-adds the entries
+	void SetConfig(const QuadTreeConfig& config);
+	//worldBounds is the area of the current root, grown from the configured one (see QuadTreeConfig::maxRootGrowth)
+	const QuadTreeConfig& GetConfig() const { return m_config; }
+	//as passed to Init / SetConfig, before any root growth
+	const QuadTreeConfig& GetInitialConfig() const { return m_initialConfig; }
+	int GetRootGrowthCount() const { return m_rootGrowthCount; }
+
+	//the search for the entry's quarter starts at startQTNodeIndex (any live node, -1 for the root)
+	int AddQTEntry(CollisionEntry* entry, int startQTNodeIndex = -1);
+	void RemoveQTEntry(CollisionEntry* entry, int QTNodeIndex, int quarter, bool ignoreMerging);
+	int SubdivideQTQuarter(int QTNodeIndex, int quarter);
+	//moves the entry to the quarter of its current position, starting from the node it is stored in
+	int RelocateQTEntry(CollisionEntry* entry);
+	//splits and merges are queued by adding and removing entries and applied here, once per Update,
+	//after growing the root over the entries that left it
+	void ApplyRestructuring();
+	//drops every entry and node, the root stays
+	void Clear();
+
+	QuadTreeNode& GetNode(int index) { return m_nodePool[index]; }
+	const QuadTreeNode& GetNode(int index) const { return m_nodePool[index]; }
+	int GetRootIndex() const { return m_rootIndex; }
+	const int& MaxEntriesPerQuarter() const { return m_config.leafCapacity; }
+
+	//quarter entries are stored inline first, then in the overflow bucket
+	int GetQuarterEntry(const QuadTreeNode& node, int quarter, int i) const;
+
+	//entries whose shape may overlap bounds (a superset, no shape test). works in both bounds modes,
+	//quarters are found through their reach, their entries are filtered by their own bounds.
+	//the queries return the number of nodes they visited
+	int QueryCandidates(const CollisionAABB& bounds, std::vector<int>& outIds, std::vector<int>& stack) const;
+
+	//area of a quarter, sides on the world border reach out to infinity (entries outside the world are clamped in)
+	CollisionAABB GetQuarterCell(const QuadTreeNode& node, int quarter) const;
+	//area the shapes stored in or below a quarter can cover: its cell grown by the largest center indexed radius
+	//and by the looseness of bounds indexed entries (see GetQuarterLooseCell). the root's straddlers excepted
+	CollisionAABB GetQuarterReach(const QuadTreeNode& node, int quarter) const;
+
+	//loose mode: recomputes every quarter's bounds from the shapes stored below it
+	void RefitLooseBounds();
+	//loose mode: collects the entries of other quarters whose loose bounds overlap bounds, for the pairs of an entry of the given quarter.
+	//the search starts at that quarter and climbs, only one of any two quarters collects the other (see the definition)
+	int QueryLooseNeighbours(const CollisionAABB& bounds, int QTNodeIndex, int quarter, std::vector<int>& outIds, std::vector<int>& stack) const;
+
+	//pool usage, for tuning the reserve
+	int GetNodeCount() const { return m_currentQTCount; }
+	int GetPeakNodeCount() const { return m_peakQTCount; }
+	int GetNodePoolCapacity() const { return static_cast<int>(m_nodePool.size()); }
+	int GetPeakOverflowBucketCount() const { return static_cast<int>(m_overflowBuckets.size()); }
+	void ReserveNodes(int nodeCount);
+
+	//node visits of the queries are counted by their callers
+	const QuadTreeStats& GetStats() const { return m_stats; }
+	void ResetStats() { m_stats = QuadTreeStats(); }
+
+	void SetObserver(ICollisionDebugLayer* observer) { m_observer = observer; }
 
 
 private:
 
-	int m_inputCallbackId = 0;
-	Entity* m_QTActiveTextEntity = nullptr;
-	TextRenderComponent* m_QTVisibilityTextComponent = nullptr;
-	bool m_showQT = false;
-
-	QuadTreeNode* m_quadTreeRoot = nullptr;
+	int AllocateNode(sf::Vector2f centerOffset, sf::Vector2u size, int parent, int parentQuarter);
+	void FreeNode(int index);
+	//depth and region from the node's parent
+	void AttachToParent(int index);
+	//remembers the extent of an entry outside the root for the next GrowRoot
+	void QueueRootGrowth(const CollisionEntry& entry);
+	void GrowRoot();
+	int GetQuarter(const QuadTreeNode& node, sf::Vector2f position) const;
+	int FindQuarterForEntry(const CollisionEntry& entry, int startQTNodeIndex, int& outQuarter);
+	//a bounds indexed entry fits a quarter when its bounds lie in the cell grown by half the quarter's size,
+	//so shapes on a cell border do not all pile up in the node above
+	CollisionAABB GetQuarterLooseCell(const QuadTreeNode& node, int quarter) const;
+	bool IsInsideRegion(const QuadTreeNode& node, sf::Vector2f position) const;
+	void QueueRestructuring(int QTNodeIndex);
+	void MergeQTNode(int QTNodeIndex);
+	void PushDownQuarterEntries(int QTNodeIndex, int quarter, int childIndex);
+	void InsertIntoQuarter(QuadTreeNode& node, int quarter, int id);
+	bool RemoveFromQuarter(QuadTreeNode& node, int quarter, int id);
+	//empties the quarter, its ids are appended to outIds
+	void TakeQuarterEntries(QuadTreeNode& node, int quarter, std::vector<int>& outIds);
+	void NotifyQuarterCountChanged(const QuadTreeNode& node, int quarter);
+	CollisionAABB RefitLooseBounds(int QTNodeIndex);
+	//after the entry was added to or moved within a root quarter
+	void UpdateRootStraddler(const CollisionEntry& entry);
+	void RemoveRootStraddler(int quarter, int id);
+
+	ICollisionDebugLayer* m_observer = nullptr;
+
+	std::vector<QuadTreeNode> m_nodePool;
+	int m_freeNodeHead = -1;
+	std::vector<std::vector<int>> m_overflowBuckets;
+	std::vector<int> m_freeOverflowBuckets;
+	std::vector<int> m_mergeScratch;
+	std::vector<int> m_restructuringQueue;
+	std::vector<int> m_queryStack;
+	//per root quarter: bounds indexed entries reaching out of the quarter's loose cell, they are queried apart from it
+	std::vector<int> m_rootStraddlerIds[4];
+	QuadTreeStats m_stats;
+
+	int m_rootIndex = -1;
 	CollisionManager* m_collisionManager = nullptr;
 	int m_quadTreeIDCounter = 0;
 	int m_currentQTCount = 0;
-	const int m_maxQuarterEntries = 2;
+	int m_peakQTCount = 0;
+	float m_maxCenterEntryRadius = 0.f;
+	int m_rootGrowthCount = 0;
+	CollisionAABB m_pendingGrowthBounds = CollisionAABB::Empty(); //of the entries that were clamped into the root since the last growth
+	QuadTreeConfig m_config;
+	QuadTreeConfig m_initialConfig;
 };
 
 class CollisionManager
 {
 public:
 
+	//engine entry point: sizes the world from the render window and attaches the debug overlay (see CollisionDebugOverlay.cpp)
 	void Init();
-
-	~CollisionManager()
-	{
-		Engine::GetInstance()->GetInputManager().Unregister(m_inputCallbackId);
-	}
-
-	int RegisterShape(Entity* pOwner, const CollisionShape& shape, sf::Vector2f position, bool isStatic, bool isTriggerVolume, const TCollisionCallbackSignature& callback);
+	//headless entry points, a world of worldSize centered on the origin or a full layout
+	void Init(sf::Vector2u worldSize);
+	void Init(const QuadTreeConfig& config);
+	CollisionManager();
+	~CollisionManager();
+
+	int RegisterShape(Entity* pOwner, const CollisionShape& shape, sf::Vector2f position, bool isStatic, bool isTriggerVolume, const TCollisionCallbackSignature& callback,
+		ECollisionIndexPolicy indexPolicy = ECollisionIndexPolicy::Auto);
 	bool UnregisterShape(int id);
 
 	CollisionEntry* FindCollisionEntryById(int id, size_t& outIndex, bool& outIsQTEntry);
+	bool IsValidId(int id) const;
+	static CollisionAABB GetEntryAABB(const CollisionEntry& entry);
+	//bounds of the hot data circle of a QT entry (enclosing boxes and swept paths), false if id is no live QT entry
+	bool GetQTEntryCircleBounds(int id, CollisionAABB& outBounds) const;
+	//swept shapes are indexed by the bounds of their path, whatever policy they were registered with
+	static bool IsIndexedByBounds(const CollisionEntry& entry) { return entry.isIndexedByBounds || entry.isSwept; }
+	//distance from position to the shape, 0 inside
+	static float GetEntryDistance(const CollisionEntry& entry, sf::Vector2f position);
+	static bool IsEntryOverlapping(const CollisionEntry& entry, const CollisionAABB& bounds);
+
+	//spatial queries over all live shapes, the indexed ones are looked up through the QuadTree (other backends scan them).
+	//results are shape ids written to a caller owned buffer, nothing is allocated.
+	//returns the number of matches, which can exceed capacity - matches past capacity are dropped
+	int QueryAABB(const CollisionAABB& bounds, int* outIds, int capacity) const;
+	int QueryRadius(sf::Vector2f center, float radius, int* outIds, int capacity) const;
+	//up to k shapes closest to position (see GetEntryDistance) within maxDistance, nearest first.
+	//outIds and outDistances hold k elements, returns the number found
+	int QueryKNearest(sf::Vector2f position, int k, int* outIds, float* outDistances, float maxDistance = FLT_MAX) const;
+	//queryCount AABB queries answered in one tree traversal. query i writes up to capacityPerQuery ids
+	//to outIds + i * capacityPerQuery and its match count (as QueryAABB returns it) to outCounts[i]
+	void QueryAABBBatch(const CollisionAABB* bounds, int queryCount, int* outIds, int capacityPerQuery, int* outCounts);
+
+	//nearest hit of every ray against all live shapes. the tree is walked front to back along each ray and the walk stops
+	//once no quarter left can hold a closer hit, circles are tested in batches by the narrowphase kernel.
+	//rays are spread over the detection threads when there are any (see SetWorkerThreadCount)
+	void RaycastBatch(const CollisionRay* rays, int rayCount, CollisionRayHit* outHits);
+	bool Raycast(const CollisionRay& ray, CollisionRayHit& outHit);
+	//fraction along origin + fraction * delta where the segment enters the shape (0 if origin is inside), -1 on a miss
+	static float GetEntryRayFraction(const CollisionEntry& entry, sf::Vector2f origin, sf::Vector2f delta);
 	
 	void UpdateShapePosition(int id, sf::Vector2f newPosition);
 	void Update(float deltaSeconds);
 
-	void OnInputPressed();
+	//continuous collision for fast moving circles (bullets): a swept shape is tested along its path from its position at the
+	//end of the last Update to its current one, so it can not pass through thin shapes in one step. pairs get their time of impact,
+	//solid pairs stop the swept side there. the broadphase sees the bounds of the whole path, the QuadTree indexes a swept shape
+	//by those bounds for as long as it stays swept (see IsIndexedByBounds).
+	//calling it again on a swept shape restarts its path at the current position, use it after teleports.
+	//returns false for boxes and static shapes, they keep the positional test
+	bool SetShapeSwept(int id, bool isSwept);
+
+	void ToggleQTCalculation();
+	void SetQTBoundsMode(EQuadTreeBoundsMode mode) { m_QTBoundsMode = mode; }
+	EQuadTreeBoundsMode GetQTBoundsMode() const { return m_QTBoundsMode; }
+	void SetBroadphaseBackend(EBroadphaseBackend backend);
+	EBroadphaseBackend GetBroadphaseBackend() const { return m_broadphaseBackend; }
+	LinearQuadTree* GetLinearQuadTree() const { return m_linearQuadTree.get(); }
+	SpatialHashGrid* GetSpatialHashGrid() const { return m_hashGrid.get(); }
+	SweepAndPrune* GetSweepAndPrune() const { return m_sweepAndPrune.get(); }
+	//the backend rebuilt every Update, nullptr for the pointer QuadTree
+	BroadphaseBackend* GetRebuiltBroadphase() const;
+	//bulk loads the static shapes, Update does that whenever they changed. calling it after loading a level keeps that work out of the first frame
+	void RebuildStaticIndex();
+	const StaticCollisionIndex* GetStaticIndex() const { return m_staticIndex.get(); }
+	const CollisionAABB& GetWorldBounds() const { return m_quadtree->GetConfig().worldBounds; }
+	bool IsUsingQTCalculation() const { return m_useQTCalculation; }
+	int GetBulletCount() const { return m_bulletCount; }
+	QuadTree* GetQuadTree() const { return m_quadtree.get(); }
+	//re-layouts the tree: every QT entry is taken out and inserted again under the new config
+	void SetQuadTreeConfig(const QuadTreeConfig& config);
+	const QuadTreeConfig& GetQuadTreeConfig() const { return m_quadtree->GetConfig(); }
+
+	//detection over the QT leaf quarters runs on this many threads (including the calling one),
+	//contacts are resolved and callbacks invoked afterwards on the calling thread.
+	//<= 1 runs the same detection jobs one after the other on the calling thread
+	void SetWorkerThreadCount(int threadCount);
+	int GetWorkerThreadCount() const;
+
+	//confirmed overlaps of the last Update in detection order, valid until the next Update
+	const std::vector<CollisionContactRecord>& GetContacts() const { return m_contactRecords; }
+	//called once at the end of every Update with all of its contacts, the batched alternative to per shape callbacks
+	void SetContactHandler(const TContactHandlerSignature& handler) { m_contactHandler = handler; }
+
+	//subscribes a shape to the enter / stay / exit events of its pairs (ECollisionEventFlags). pairs with a subscribed side
+	//are kept in a persistent pair cache and diffed against the previous Update; events go out at the end of Update.
+	//shapes that only need enter / exit pass a null callback to RegisterShape, a held overlap then calls nothing.
+	//called from a collision callback, it takes effect once the running dispatch is done
+	void SetCollisionEvents(int id, uint8_t eventMask, const TCollisionEventSignature& callback);
+
+	//pairs tested since the last reset, each pair once: by its bounding circle test, or by its shape test if it had none (benchmarks)
+	long long GetPairTestCount() const { return m_pairTestCount; }
+	void ResetPairTestCount() { m_pairTestCount = 0; }
+
+	//counters of the last Update, see CollisionFrameStats
+	const CollisionFrameStats& GetFrameStats() const { return m_lastFrameStats; }
+	//every Update's stats are pushed into the recorder, nullptr stops recording
+	void SetStatsRecorder(std::unique_ptr<CollisionStatsRecorder> recorder) { m_statsRecorder = std::move(recorder); }
+	CollisionStatsRecorder* GetStatsRecorder() const { return m_statsRecorder.get(); }
+	//captures the workload for offline playback (see CollisionReplay.h): the shapes registered right now, then every
+	//RegisterShape, UnregisterShape, UpdateShapePosition, SetShapeSwept and Update. nullptr stops and closes the capture
+	void SetReplayRecorder(std::unique_ptr<CollisionReplayRecorder> recorder);
+	CollisionReplayRecorder* GetReplayRecorder() const { return m_replayRecorder.get(); }
+
+	//resolved positions are pushed back to the owner through this hook, without one the shape is moved directly
+	void SetOwnerMoveCallback(const TOwnerMoveSignature& callback) { m_ownerMoveCallback = callback; }
+	void SetDebugLayer(std::unique_ptr<ICollisionDebugLayer> debugLayer) { m_debugLayer = std::move(debugLayer); }
 
 
 protected:
 
-	void CheckForQTCollisions(QuadTreeNode* root);
-	void CheckForQTQuarterCollisions(QuadTreeNode* root, int quarter);
+	void CheckForQTCollisions();
+	void CollectQTLeafJobs(int QTNodeIndex);
+	void CheckForRebuiltBroadphaseCollisions(BroadphaseBackend& broadphase);
+	bool IsUsingPointerQuadTree() const { return m_useQTCalculation && m_broadphaseBackend == EBroadphaseBackend::QuadTree; }
 	void CheckForNonQTCollisions(bool includeQTEntries = false);
+	void CheckForStaticCollisions(bool includeQTEntries = true);
+	void HandleStaticCollision(int lhsId, int rhsId);
+	//HandleCollision counts the pair as tested, HandleShapeCollision is for pairs a bounding circle test counted already
+	void HandleCollision(CollisionEntry& lhs, CollisionEntry& rhs);
+	void HandleShapeCollision(CollisionEntry& lhs, CollisionEntry& rhs);
+	void ResolveCollision(CollisionEntry& lhs, CollisionEntry& rhs);
 	void HandleCollision_Circle_Circle(CollisionEntry& lhs, CollisionEntry& rhs);
+	void ResolveCollision_Circle_Circle(CollisionEntry& lhs, CollisionEntry& rhs);
+	void ApplyContact_Circle_Circle(CollisionEntry& lhs, CollisionEntry& rhs, sf::Vector2f normal, float depth);
 	void HandleCollision_Circle_Box(CollisionEntry& lhs, CollisionEntry& rhs);
 	void HandleCollision_Box_Box(CollisionEntry& lhs, CollisionEntry& rhs);
+	//false if the pair already overlaps at the start of the sweep, the positional test takes over then
+	bool HandleCollision_Swept(CollisionEntry& lhs, CollisionEntry& rhs);
+	//circle center moving origin + t * delta against a box of halfExtents at the origin, rounded corners included
+	static bool GetSweptCircleBoxFraction(sf::Vector2f origin, sf::Vector2f delta, float radius, sf::Vector2f halfExtents, float& outFraction);
+	//the next sweep starts where this Update left the swept shapes
+	void EndSweeps();
 
 	sf::Vector2f GetCircleBoxSolveDirection(sf::Vector2f difference) const;
 
+	void MoveOwner(CollisionEntry& entry, sf::Vector2f position);
+	//confirmed overlap: appends the contact record and records the pair for the events
+	void NotifyOverlap(CollisionEntry& lhs, CollisionEntry& rhs, sf::Vector2f resolveVectorLhs, sf::Vector2f resolveVectorRhs);
+	void DispatchContactCallbacks();
+	void DispatchCollisionEvents();
+	void DispatchCollisionEvent(ECollisionEventType type, int selfId, int otherId);
+	static uint64_t MakePairKey(int lhsId, int rhsId);
+	void ReinsertQTEntries();
+	void SetBulletCount(int bulletCount);
+
+	//id <-> dense index registry (generational slot map)
+	//an id encodes the slot index in the lower bits and the slot generation in the upper bits,
+	//so ids of removed shapes never alias newly registered ones
+	struct CollisionEntrySlot
+	{
+		int generation = 1;
+		int denseIndex = -1;
+		int nextFreeSlot = -1;
+		bool isQTEntry = false;
+		bool isStaticEntry = false; //in m_shapes_static, see StaticCollisionIndex
+	};
+
+	static constexpr int s_slotIndexBits = 20;
+	static constexpr int s_slotIndexMask = (1 << s_slotIndexBits) - 1;
+	static constexpr int s_maxSlotGeneration = (1 << (31 - s_slotIndexBits)) - 1;
+
+	//one leaf quarter of the pointer tree, the unit of work of the detection
+	struct QTLeafJob
+	{
+		int QTNodeIndex = -1;
+		int quarter = 0;
+		bool isBoundsQuery = false; //strict: the bounds indexed entries of the quarter query the tree for their pairs instead
+		int staticQueryBegin = -1; //!= -1: the QT entries [staticQueryBegin, staticQueryEnd) query the static index instead
+		int staticQueryEnd = -1;
+
+		//where the job left its contacts: [contactBegin, contactEnd) of that worker's buffer
+		int worker = 0;
+		int contactBegin = 0;
+		int contactEnd = 0;
+	};
+
+	//scratch owned by one detection thread, nothing in here is shared
+	struct CollisionWorkerContext
+	{
+		CollisionCircleBatch circleBatch;
+		std::vector<int> kernelHits;
+		std::vector<int> entryIds;
+		std::vector<int> neighbourIds;
+		std::vector<int> queryStack;
+		std::vector<CollisionContact> contacts;
+		long long pairTestCount = 0;
+		long long nodeVisitCount = 0;
+	};
+
+	void DetectQTLeafContacts(const QTLeafJob& job, CollisionWorkerContext& context) const;
+	void DetectBoundsEntryContacts(const QTLeafJob& job, CollisionWorkerContext& context) const;
+	void DetectStaticContacts(int begin, int end, CollisionWorkerContext& context) const;
+	void DetectCircleBatchContacts(int lhsDenseIndex, const CollisionCircleBatch& batch, int begin, CollisionWorkerContext& context) const;
+	//candidates of bounds indexed entries into the context's batch: the bounds indexed ones sorted by id first
+	//(outBoundsEntryCount of them), the center indexed ones after. returns the nodes visited
+	int GatherBoundsEntryCandidates(const CollisionAABB& bounds, CollisionWorkerContext& context, int& outBoundsEntryCount) const;
+	int GetQTDenseIndex(int id) const;
+
+	//state of one QueryAABB / QueryRadius call
+	struct RangeQuery
+	{
+		CollisionAABB bounds;
+		sf::Vector2f center;
+		float radius = -1.f; //>= 0: radius query around center, else AABB query over bounds
+		int* outIds = nullptr;
+		int capacity = 0;
+		int count = 0;
+	};
+
+	//state of one QueryKNearest call, outIds / outDistances are kept sorted
+	struct KNearestQuery
+	{
+		sf::Vector2f position;
+		int k = 0;
+		int* outIds = nullptr;
+		float* outDistances = nullptr;
+		float maxDistance = FLT_MAX;
+		int count = 0;
+
+		float GetSearchRadius() const { return count == k ? outDistances[k - 1] : maxDistance; }
+	};
+
+	struct AABBBatchQuery
+	{
+		const CollisionAABB* bounds = nullptr;
+		int* outIds = nullptr;
+		int capacityPerQuery = 0;
+		int* outCounts = nullptr;
+	};
+
+	void QueryRange(RangeQuery& query) const;
+	void QueryRange(int QTNodeIndex, RangeQuery& query) const;
+	void TestRangeQueryEntry(const CollisionEntry& entry, RangeQuery& query) const;
+	void QueryKNearest(int QTNodeIndex, KNearestQuery& query) const;
+	void TestKNearestEntry(const CollisionEntry& entry, KNearestQuery& query) const;
+	void QueryAABBBatch(int QTNodeIndex, int activeBegin, int activeEnd, const AABBBatchQuery& batch);
+	void TestAABBBatchEntry(const CollisionEntry& entry, int query, const AABBBatchQuery& batch) const;
+
+	//state of one ray of a RaycastBatch, hitId / fraction is the nearest hit so far
+	struct RayCast
+	{
+		sf::Vector2f origin;
+		sf::Vector2f delta;
+		int ignoreId = 0;
+		int hitId = 0;
+		float fraction = 1.f;
+	};
+
+	void CastRay(const CollisionRay& ray, CollisionRayHit& outHit, CollisionCircleBatch& batch) const;
+	void CastRay(int QTNodeIndex, RayCast& cast, CollisionCircleBatch& batch) const;
+	void CastRayThroughQuarter(const QuadTreeNode& QTNode, int quarter, RayCast& cast, CollisionCircleBatch& batch) const;
+	void TestRayEntry(const CollisionEntry& entry, RayCast& cast) const;
+
+	//visitor(entry) for the static shapes whose AABB may overlap bounds
+	template<typename TVisitor>
+	void ForEachStaticCandidate(const CollisionAABB& bounds, TVisitor&& visitor) const;
+
+	int AllocateSlot(bool isQTEntry, bool isStaticEntry, size_t denseIndex);
+	void RemoveEntryAt(std::vector<CollisionEntry>& shapes, size_t index);
+	//around invoking the callbacks by reference, see m_isDispatchingCallbacks
+	void BeginCallbackDispatch();
+	void EndCallbackDispatch();
 
 	std::vector<CollisionEntry> m_shapes_nonQT;
 	std::vector<CollisionEntry> m_shapes_QT;
+	std::vector<CollisionEntry> m_shapes_static;
 	std::vector<int> m_deletedShapeIndices;
+	std::vector<int> m_neighbourEntryScratch;
+	std::vector<int> m_queryStack;
+	std::vector<int> m_batchQueryScratch; //active query indices of every level of a QueryAABBBatch traversal
+	CollisionCircleBatch m_rayCircleBatch; //own batch, rays may be cast from callbacks while the detection scratch is in use
+	CollisionEntrySoA m_QTSoA;
+	//pair cache, sorted (lower id << 32 | higher id) keys of the overlapping pairs with an event subscriber
+	std::vector<uint64_t> m_pairKeys;
+	std::vector<uint64_t> m_previousPairKeys;
+	std::vector<int> m_kernelHits;
+	std::vector<CollisionPair> m_candidatePairs;
 	bool m_isIteratingShapes = false;
-	int m_idCounter = 0;
 
-	int m_inputCallbackId = 0;
-	Entity* m_QTActiveTextEntity = nullptr;
-	TextRenderComponent* m_QTActiveTextComponent = nullptr;
-	Entity* m_BulletCountTextEntity = nullptr;
-	TextRenderComponent* m_BulletCountTextComponent = nullptr;
+	std::vector<CollisionEntrySlot> m_slots;
+	int m_freeSlotHead = -1;
+
+	//per slot, out of CollisionEntry so the entries stay trivially copyable
+	struct CollisionEntryCallbacks
+	{
+		TCollisionCallbackSignature callback;
+		TCollisionEventSignature eventCallback;
+	};
+
+	//a deque, registering shapes from a callback appends without moving the callback being invoked
+	std::deque<CollisionEntryCallbacks> m_entryCallbacks;
+	//while set, released slots keep their callbacks and stay off the free list until the dispatch ends
+	bool m_isDispatchingCallbacks = false;
+	std::vector<int> m_pendingFreeSlots;
+	//SetCollisionEvents calls from the callbacks, the event callback they replace may be running
+	struct PendingCollisionEvents
+	{
+		int id = 0;
+		uint8_t eventMask = 0;
+		TCollisionEventSignature callback;
+	};
+	std::vector<PendingCollisionEvents> m_pendingCollisionEvents;
+	int m_callbackShapeCount = 0;
+	int m_sweptShapeCount = 0;
+	std::vector<CollisionContactRecord> m_contactRecords;
+	TContactHandlerSignature m_contactHandler;
+
 	int m_bulletCount = 0;
+	long long m_pairTestCount = 0;
+
+	//closes the frame's counters at the end of Update
+	void EndFrameStats();
+	int CountContainerGrowth();
+
+	CollisionFrameStats m_frameStats;
+	CollisionFrameStats m_lastFrameStats;
+	std::unique_ptr<CollisionStatsRecorder> m_statsRecorder;
+	std::unique_ptr<CollisionReplayRecorder> m_replayRecorder;
+	std::vector<size_t> m_trackedCapacities;
+	TOwnerMoveSignature m_ownerMoveCallback;
 
 	std::unique_ptr<QuadTree> m_quadtree;
 	bool m_useQTCalculation = true;
+	EQuadTreeBoundsMode m_QTBoundsMode = EQuadTreeBoundsMode::Loose;
+	EBroadphaseBackend m_broadphaseBackend = EBroadphaseBackend::QuadTree;
+	std::unique_ptr<LinearQuadTree> m_linearQuadTree;
+	std::unique_ptr<SpatialHashGrid> m_hashGrid;
+	std::unique_ptr<SweepAndPrune> m_sweepAndPrune;
+	std::unique_ptr<StaticCollisionIndex> m_staticIndex;
+	bool m_isStaticIndexDirty = false;
+
+	std::unique_ptr<CollisionJobSystem> m_jobSystem;
+	std::vector<CollisionWorkerContext> m_workerContexts;
+	std::vector<QTLeafJob> m_leafJobs;
+	static constexpr int s_staticQueryJobSize = 512;
+
+	//declared after m_quadtree so the overlay detaches before the tree is torn down
+	std::unique_ptr<ICollisionDebugLayer> m_debugLayer;
 
 };
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "CollisionProfiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <ostream>
+
+CollisionProfiler::ScopedZone::ScopedZone(const char* name)
+	: m_name(name)
+{
+	CollisionProfiler& profiler = CollisionProfiler::GetInstance();
+	if (profiler.IsCapturing())
+		m_beginNs = profiler.GetTimeNs();
+}
+
+CollisionProfiler::ScopedZone::~ScopedZone()
+{
+	if (m_beginNs < 0)
+		return;
+
+	CollisionProfiler& profiler = CollisionProfiler::GetInstance();
+	if (profiler.IsCapturing())
+		profiler.Record(m_name, m_beginNs, profiler.GetTimeNs());
+}
+
+CollisionProfiler& CollisionProfiler::GetInstance()
+{
+	static CollisionProfiler s_instance;
+	return s_instance;
+}
+
+CollisionProfiler::CollisionProfiler()
+{
+	m_epochNs = GetTimeNs();
+}
+
+int64_t CollisionProfiler::GetTimeNs() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - m_epochNs;
+}
+
+CollisionProfiler::ThreadBuffer& CollisionProfiler::GetThreadBuffer()
+{
+	//registered once per thread, the only lock of the recording path
+	thread_local ThreadBuffer* t_buffer = nullptr;
+	if (t_buffer)
+		return *t_buffer;
+
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+	std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+	buffer->events.resize(m_threadCapacity);
+	buffer->threadId = static_cast<int>(m_buffers.size());
+	t_buffer = buffer.get();
+	m_buffers.push_back(std::move(buffer));
+	return *t_buffer;
+}
+
+void CollisionProfiler::Record(const char* name, int64_t beginNs, int64_t endNs)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	//only this thread writes the buffer, the release publishes the event to the export
+	const int index = buffer.count.load(std::memory_order_relaxed);
+	if (index >= static_cast<int>(buffer.events.size()))
+	{
+		buffer.droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	TraceEvent& event = buffer.events[index];
+	event.name = name;
+	event.beginNs = beginNs;
+	event.durationNs = endNs - beginNs;
+	buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void CollisionProfiler::BeginCapture()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_buffersMutex);
+		for (const std::unique_ptr<ThreadBuffer>& buffer : m_buffers)
+		{
+			buffer->count.store(0, std::memory_order_relaxed);
+			buffer->droppedCount.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	m_isCapturing.store(true, std::memory_order_release);
+}
+
+void CollisionProfiler::EndCapture()
+{
+	m_isCapturing.store(false, std::memory_order_release);
+}
+
+long long CollisionProfiler::GetDroppedEventCount() const
+{
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+
+	long long droppedCount = 0;
+	for (const std::unique_ptr<ThreadBuffer>& buffer : m_buffers)
+	{
+		droppedCount += buffer->droppedCount.load(std::memory_order_relaxed);
+	}
+	return droppedCount;
+}
+
+void CollisionProfiler::WriteChromeTrace(std::ostream& stream) const
+{
+	std::lock_guard<std::mutex> lock(m_buffersMutex);
+
+	//complete events ("ph":"X"), timestamps and durations in microseconds
+	stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+	bool isFirst = true;
+	for (const std::unique_ptr<ThreadBuffer>& buffer : m_buffers)
+	{
+		const int count = buffer->count.load(std::memory_order_acquire);
+		for (int i = 0; i < count; i++)
+		{
+			const TraceEvent& event = buffer->events[i];
+			stream << (isFirst ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"collision\",\"ph\":\"X\",\"ts\":"
+				<< event.beginNs / 1000 << '.' << (event.beginNs % 1000) / 100 << (event.beginNs % 100) / 10 << event.beginNs % 10
+				<< ",\"dur\":" << event.durationNs / 1000 << '.' << (event.durationNs % 1000) / 100 << (event.durationNs % 100) / 10 << event.durationNs % 10
+				<< ",\"pid\":1,\"tid\":" << buffer->threadId << '}';
+			isFirst = false;
+		}
+	}
+
+	stream << "\n]}\n";
+}
+
+bool CollisionProfiler::WriteChromeTrace(const char* path) const
+{
+	std::ofstream stream(path);
+	if (!stream)
+		return false;
+
+	WriteChromeTrace(stream);
+	return static_cast<bool>(stream);
+}
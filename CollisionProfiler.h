@@ -0,0 +1,91 @@
+#pragma once
+
+//#define COLLISION_PROFILING
+
+//scoped timing zones of the collision hot paths, exported as Chrome trace_event JSON (chrome://tracing, ui.perfetto.dev).
+//without COLLISION_PROFILING the zones compile to nothing; with it a zone costs one relaxed load while no capture runs.
+//every thread writes into its own fixed size buffer, single writer, so recording takes no lock.
+//events past a buffer's capacity are dropped and counted
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef COLLISION_PROFILING
+#define COLLISION_PROFILE_CONCAT_INNER(a, b) a##b
+#define COLLISION_PROFILE_CONCAT(a, b) COLLISION_PROFILE_CONCAT_INNER(a, b)
+//name must be a string literal (or outlive the export)
+#define COLLISION_PROFILE_ZONE(name) CollisionProfiler::ScopedZone COLLISION_PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#else
+#define COLLISION_PROFILE_ZONE(name)
+#endif
+
+class CollisionProfiler
+{
+public:
+	struct TraceEvent
+	{
+		const char* name = nullptr;
+		int64_t beginNs = 0;
+		int64_t durationNs = 0;
+	};
+
+	class ScopedZone
+	{
+	public:
+		explicit ScopedZone(const char* name);
+		~ScopedZone();
+
+		ScopedZone(const ScopedZone&) = delete;
+		ScopedZone& operator=(const ScopedZone&) = delete;
+
+	private:
+		const char* m_name;
+		int64_t m_beginNs = -1; //-1: no capture running at the start of the zone
+	};
+
+	static CollisionProfiler& GetInstance();
+
+	//events per thread, applies to buffers created afterwards
+	void SetThreadCapacity(int eventCount) { m_threadCapacity = eventCount > 0 ? eventCount : 1; }
+
+	//drops the recorded events and starts recording, zones already open at this point are not recorded
+	void BeginCapture();
+	void EndCapture();
+	bool IsCapturing() const { return m_isCapturing.load(std::memory_order_relaxed); }
+
+	//after EndCapture, with no zone of the capture still open
+	void WriteChromeTrace(std::ostream& stream) const;
+	//false if the file can not be opened
+	bool WriteChromeTrace(const char* path) const;
+
+	long long GetDroppedEventCount() const;
+
+	int64_t GetTimeNs() const;
+	void Record(const char* name, int64_t beginNs, int64_t endNs);
+
+private:
+
+	struct ThreadBuffer
+	{
+		std::vector<TraceEvent> events;
+		std::atomic<int> count{ 0 };
+		std::atomic<long long> droppedCount{ 0 };
+		int threadId = 0;
+	};
+
+	CollisionProfiler();
+	ThreadBuffer& GetThreadBuffer();
+
+	std::atomic<bool> m_isCapturing{ false };
+	int m_threadCapacity = 1 << 16;
+
+	//buffers outlive their threads, so the job system's workers can be stopped before the export
+	mutable std::mutex m_buffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+
+	int64_t m_epochNs = 0;
+};
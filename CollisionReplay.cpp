@@ -0,0 +1,320 @@
+#include "CollisionReplay.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr uint8_t REPLAY_FLAG_STATIC = 1 << 0;
+	constexpr uint8_t REPLAY_FLAG_TRIGGER = 1 << 1;
+	constexpr uint8_t REPLAY_FLAG_CALLBACK = 1 << 2;
+}
+
+CollisionReplayRecorder::CollisionReplayRecorder(const char* path)
+	: m_stream(path, std::ios::binary | std::ios::trunc)
+{
+	m_buffer.reserve(s_flushSize + 64);
+}
+
+CollisionReplayRecorder::~CollisionReplayRecorder()
+{
+	Flush();
+}
+
+void CollisionReplayRecorder::Flush()
+{
+	if (!m_buffer.empty())
+		m_stream.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+
+	m_buffer.clear();
+	m_stream.flush();
+}
+
+template<typename T>
+void CollisionReplayRecorder::Append(const T& value)
+{
+	const size_t offset = m_buffer.size();
+	m_buffer.resize(offset + sizeof(T));
+	std::memcpy(m_buffer.data() + offset, &value, sizeof(T));
+}
+
+void CollisionReplayRecorder::WriteHeader(const QuadTreeConfig& config)
+{
+	CollisionReplayHeader header;
+	header.worldMinX = config.worldBounds.min.x;
+	header.worldMinY = config.worldBounds.min.y;
+	header.worldMaxX = config.worldBounds.max.x;
+	header.worldMaxY = config.worldBounds.max.y;
+	header.leafCapacity = config.leafCapacity;
+	header.mergeCapacity = config.mergeCapacity;
+	header.minCellExtent = config.minCellExtent;
+	header.maxDepth = config.maxDepth;
+	header.maxRootGrowth = config.maxRootGrowth;
+	Append(header);
+}
+
+void CollisionReplayRecorder::WriteRegister(int id, const CollisionShape& shape, sf::Vector2f position, bool isStatic, bool isTriggerVolume, bool hasCallback,
+	ECollisionIndexPolicy indexPolicy)
+{
+	uint8_t flags = 0;
+	if (isStatic) flags |= REPLAY_FLAG_STATIC;
+	if (isTriggerVolume) flags |= REPLAY_FLAG_TRIGGER;
+	if (hasCallback) flags |= REPLAY_FLAG_CALLBACK;
+
+	Append(ECollisionReplayRecord::Register);
+	Append(static_cast<int32_t>(id));
+	Append(static_cast<uint8_t>(shape.type));
+	Append(flags);
+	Append(static_cast<uint8_t>(indexPolicy));
+	Append(shape.radius);
+	Append(shape.width);
+	Append(shape.height);
+	Append(position.x);
+	Append(position.y);
+}
+
+void CollisionReplayRecorder::WriteUnregister(int id)
+{
+	Append(ECollisionReplayRecord::Unregister);
+	Append(static_cast<int32_t>(id));
+}
+
+void CollisionReplayRecorder::WriteMove(int id, sf::Vector2f position)
+{
+	Append(ECollisionReplayRecord::Move);
+	Append(static_cast<int32_t>(id));
+	Append(position.x);
+	Append(position.y);
+}
+
+void CollisionReplayRecorder::WriteSwept(int id, bool isSwept)
+{
+	Append(ECollisionReplayRecord::Swept);
+	Append(static_cast<int32_t>(id));
+	Append(static_cast<uint8_t>(isSwept));
+}
+
+void CollisionReplayRecorder::WriteUpdate(float deltaSeconds)
+{
+	Append(ECollisionReplayRecord::Update);
+	Append(deltaSeconds);
+	m_frameCount++;
+
+	//only between frames, so a flush never lands inside the detection
+	if (m_buffer.size() >= s_flushSize)
+		Flush();
+}
+
+CollisionReplayFile::~CollisionReplayFile()
+{
+	Close();
+}
+
+bool CollisionReplayFile::Open(const char* path)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (view == nullptr)
+	{
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = static_cast<const uint8_t*>(view);
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	const int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	//the mapping keeps the file alive
+	close(file);
+	if (view == MAP_FAILED)
+		return false;
+
+	madvise(view, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+	m_data = static_cast<const uint8_t*>(view);
+	m_size = static_cast<size_t>(status.st_size);
+#endif
+
+	return true;
+}
+
+void CollisionReplayFile::Close()
+{
+	if (m_data == nullptr)
+		return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
+
+CollisionReplayPlayer::CollisionReplayPlayer(const uint8_t* data, size_t size)
+	: m_data(data)
+	, m_size(size)
+	, m_callback([](const CollisionEntry&, const CollisionEntry&, sf::Vector2f) {})
+{
+	m_isValid = Read(m_header) && m_header.magic == CollisionReplayHeader::s_magic && m_header.version == CollisionReplayHeader::s_version;
+	Rewind();
+}
+
+QuadTreeConfig CollisionReplayPlayer::GetConfig() const
+{
+	QuadTreeConfig config;
+	config.worldBounds = { sf::Vector2f(m_header.worldMinX, m_header.worldMinY), sf::Vector2f(m_header.worldMaxX, m_header.worldMaxY) };
+	config.leafCapacity = m_header.leafCapacity;
+	config.mergeCapacity = m_header.mergeCapacity;
+	config.minCellExtent = m_header.minCellExtent;
+	config.maxDepth = m_header.maxDepth;
+	config.maxRootGrowth = m_header.maxRootGrowth;
+	return config;
+}
+
+void CollisionReplayPlayer::Rewind()
+{
+	m_offset = sizeof(CollisionReplayHeader);
+	m_frameIndex = 0;
+	m_isCorrupt = false;
+	m_ids.clear();
+}
+
+template<typename T>
+bool CollisionReplayPlayer::Read(T& outValue)
+{
+	if (m_offset + sizeof(T) > m_size)
+		return false;
+
+	std::memcpy(&outValue, m_data + m_offset, sizeof(T));
+	m_offset += sizeof(T);
+	return true;
+}
+
+int CollisionReplayPlayer::MapId(int recordedId) const
+{
+	//0 is never a valid id, the manager then ignores the call
+	const auto it = m_ids.find(recordedId);
+	return it != m_ids.end() ? it->second : 0;
+}
+
+bool CollisionReplayPlayer::PlayFrame(CollisionManager& collisionManager)
+{
+	if (!m_isValid || m_isCorrupt)
+		return false;
+
+	uint8_t record;
+	while (Read(record))
+	{
+		bool isRead = false;
+		int32_t id = 0;
+
+		switch (static_cast<ECollisionReplayRecord>(record))
+		{
+		case ECollisionReplayRecord::Register:
+		{
+			uint8_t type = 0, flags = 0, indexPolicy = 0;
+			CollisionShape shape;
+			sf::Vector2f position;
+			isRead = Read(id) && Read(type) && Read(flags) && Read(indexPolicy) && Read(shape.radius) && Read(shape.width) && Read(shape.height)
+				&& Read(position.x) && Read(position.y);
+			if (!isRead)
+				break;
+
+			shape.type = static_cast<EShapeType>(type);
+			m_ids[id] = collisionManager.RegisterShape(nullptr, shape, position, (flags & REPLAY_FLAG_STATIC) != 0, (flags & REPLAY_FLAG_TRIGGER) != 0,
+				(flags & REPLAY_FLAG_CALLBACK) ? m_callback : TCollisionCallbackSignature(), static_cast<ECollisionIndexPolicy>(indexPolicy));
+			break;
+		}
+		case ECollisionReplayRecord::Unregister:
+			isRead = Read(id);
+			if (isRead)
+			{
+				collisionManager.UnregisterShape(MapId(id));
+				m_ids.erase(id);
+			}
+			break;
+		case ECollisionReplayRecord::Move:
+		{
+			sf::Vector2f position;
+			isRead = Read(id) && Read(position.x) && Read(position.y);
+			if (isRead)
+				collisionManager.UpdateShapePosition(MapId(id), position);
+			break;
+		}
+		case ECollisionReplayRecord::Swept:
+		{
+			uint8_t isSwept = 0;
+			isRead = Read(id) && Read(isSwept);
+			if (isRead)
+				collisionManager.SetShapeSwept(MapId(id), isSwept != 0);
+			break;
+		}
+		case ECollisionReplayRecord::Update:
+		{
+			float deltaSeconds = 0.f;
+			isRead = Read(deltaSeconds);
+			if (!isRead)
+				break;
+
+			collisionManager.Update(deltaSeconds);
+			m_frameIndex++;
+			return true;
+		}
+		default:
+			break;
+		}
+
+		if (!isRead)
+		{
+			m_isCorrupt = true;
+			return false;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+//binary capture of a CollisionManager workload and its headless playback, to profile a recorded hitch offline against every backend.
+//the stream is a header (format version and the QuadTreeConfig) followed by packed records in call order:
+//RegisterShape, UnregisterShape, UpdateShapePosition and SetShapeSwept calls, and one Update record per frame.
+//attaching a recorder first writes the shapes already registered, so a capture can start in the middle of a match. the pointer
+//QuadTree is then built from scratch on playback, its strict mode pairs can differ for the first frames until the layouts agree.
+//callbacks, events and owners are not captured; replayed shapes that had a callback get one that does nothing.
+//removals requested from a callback are played back after their Update instead of being skipped for the rest of it.
+//fields are written in the byte order of the recording machine
+
+#include "CollisionManager.h"
+
+#include <cstdint>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+enum class ECollisionReplayRecord : uint8_t
+{
+	Register,	//id, shape, flags, index policy, position
+	Unregister,	//id
+	Move,		//id, position
+	Swept,		//id, isSwept
+	Update		//deltaSeconds, ends a frame
+};
+
+struct CollisionReplayHeader
+{
+	static constexpr uint32_t s_magic = 0x4C504552; //"REPL"
+	static constexpr uint32_t s_version = 2;
+
+	uint32_t magic = s_magic;
+	uint32_t version = s_version;
+	float worldMinX = 0.f;
+	float worldMinY = 0.f;
+	float worldMaxX = 0.f;
+	float worldMaxY = 0.f;
+	int32_t leafCapacity = 0;
+	int32_t mergeCapacity = 0;
+	float minCellExtent = 0.f;
+	int32_t maxDepth = 0;
+	int32_t maxRootGrowth = 0;
+};
+
+//owned by the CollisionManager it records, see CollisionManager::SetReplayRecorder.
+//records are collected in memory and written out in blocks
+class CollisionReplayRecorder
+{
+public:
+	explicit CollisionReplayRecorder(const char* path);
+	~CollisionReplayRecorder();
+
+	CollisionReplayRecorder(const CollisionReplayRecorder&) = delete;
+	CollisionReplayRecorder& operator=(const CollisionReplayRecorder&) = delete;
+
+	//false if the file could not be opened or a write failed
+	bool IsGood() const { return static_cast<bool>(m_stream); }
+	//writes the buffered records, e.g. right after a hitch
+	void Flush();
+
+	long long GetFrameCount() const { return m_frameCount; }
+
+	void WriteHeader(const QuadTreeConfig& config);
+	void WriteRegister(int id, const CollisionShape& shape, sf::Vector2f position, bool isStatic, bool isTriggerVolume, bool hasCallback, ECollisionIndexPolicy indexPolicy);
+	void WriteUnregister(int id);
+	void WriteMove(int id, sf::Vector2f position);
+	void WriteSwept(int id, bool isSwept);
+	void WriteUpdate(float deltaSeconds);
+
+private:
+
+	template<typename T>
+	void Append(const T& value);
+	void Append(ECollisionReplayRecord record) { Append(static_cast<uint8_t>(record)); }
+
+	std::ofstream m_stream;
+	std::vector<char> m_buffer;
+	long long m_frameCount = 0;
+	static constexpr size_t s_flushSize = 1 << 16;
+};
+
+//read only memory mapping of a recorded file, nothing is copied
+class CollisionReplayFile
+{
+public:
+	CollisionReplayFile() = default;
+	~CollisionReplayFile();
+
+	CollisionReplayFile(const CollisionReplayFile&) = delete;
+	CollisionReplayFile& operator=(const CollisionReplayFile&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	const uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
+
+//feeds a recorded stream into a CollisionManager one frame at a time, as fast as it goes.
+//recorded ids are mapped to the ids the manager hands out on playback
+class CollisionReplayPlayer
+{
+public:
+	//the data has to outlive the player
+	CollisionReplayPlayer(const uint8_t* data, size_t size);
+
+	//false if the header is missing or of another format version
+	bool IsValid() const { return m_isValid; }
+	QuadTreeConfig GetConfig() const;
+
+	//applies the records up to the next Update record and runs that Update.
+	//false at the end of the stream (records after the last Update are applied without one) or on a truncated record
+	bool PlayFrame(CollisionManager& collisionManager);
+	//back to the first record, for a run on a fresh manager
+	void Rewind();
+
+	long long GetFrameIndex() const { return m_frameIndex; }
+	bool IsCorrupt() const { return m_isCorrupt; }
+
+private:
+
+	template<typename T>
+	bool Read(T& outValue);
+	int MapId(int recordedId) const;
+
+	const uint8_t* m_data;
+	size_t m_size;
+	size_t m_offset = 0;
+	CollisionReplayHeader m_header;
+	bool m_isValid = false;
+	bool m_isCorrupt = false;
+	long long m_frameIndex = 0;
+
+	std::unordered_map<int, int> m_ids;
+	TCollisionCallbackSignature m_callback;
+};
@@ -0,0 +1,86 @@
+#include "CollisionStats.h"
+
+#include <cassert>
+#include <fstream>
+#include <ostream>
+
+CollisionStatsRecorder::CollisionStatsRecorder(int capacity)
+	: m_frames(capacity > 0 ? capacity : 1)
+{
+}
+
+void CollisionStatsRecorder::Push(const CollisionFrameStats& stats)
+{
+	m_frames[m_next] = stats;
+	m_next = (m_next + 1) % GetCapacity();
+	if (m_count < GetCapacity())
+		m_count++;
+}
+
+void CollisionStatsRecorder::Clear()
+{
+	m_next = 0;
+	m_count = 0;
+}
+
+const CollisionFrameStats& CollisionStatsRecorder::GetFrame(int index) const
+{
+	assert(index >= 0 && index < m_count);
+
+	//the oldest frame sits where the next one goes once the buffer wrapped
+	const int oldest = m_count < GetCapacity() ? 0 : m_next;
+	return m_frames[(oldest + index) % GetCapacity()];
+}
+
+void CollisionStatsRecorder::WriteJsonLines(std::ostream& stream) const
+{
+	for (int i = 0; i < m_count; i++)
+	{
+		const CollisionFrameStats& stats = GetFrame(i);
+		stream << "{\"frame\":" << stats.frame
+			<< ",\"shapes\":" << stats.shapeCount
+			<< ",\"broadphase_tests\":" << stats.broadphaseTests
+			<< ",\"candidate_pairs\":" << stats.candidatePairs
+			<< ",\"narrowphase_tests\":" << stats.narrowphaseTests
+			<< ",\"overlaps\":" << stats.overlaps
+			<< ",\"node_visits\":" << stats.nodeVisits
+			<< ",\"subdivisions\":" << stats.subdivisions
+			<< ",\"merges\":" << stats.merges
+			<< ",\"reinsertions\":" << stats.reinsertions
+			<< ",\"entry_lookups\":" << stats.entryLookups
+			<< ",\"allocations\":" << stats.allocations << "}\n";
+	}
+}
+
+void CollisionStatsRecorder::WriteCsv(std::ostream& stream) const
+{
+	stream << "frame,shapes,broadphase_tests,candidate_pairs,narrowphase_tests,overlaps,node_visits,subdivisions,merges,reinsertions,entry_lookups,allocations\n";
+
+	for (int i = 0; i < m_count; i++)
+	{
+		const CollisionFrameStats& stats = GetFrame(i);
+		stream << stats.frame << ',' << stats.shapeCount << ',' << stats.broadphaseTests << ',' << stats.candidatePairs << ','
+			<< stats.narrowphaseTests << ',' << stats.overlaps << ',' << stats.nodeVisits << ',' << stats.subdivisions << ','
+			<< stats.merges << ',' << stats.reinsertions << ',' << stats.entryLookups << ',' << stats.allocations << '\n';
+	}
+}
+
+bool CollisionStatsRecorder::WriteJsonLines(const char* path) const
+{
+	std::ofstream stream(path);
+	if (!stream)
+		return false;
+
+	WriteJsonLines(stream);
+	return static_cast<bool>(stream);
+}
+
+bool CollisionStatsRecorder::WriteCsv(const char* path) const
+{
+	std::ofstream stream(path);
+	if (!stream)
+		return false;
+
+	WriteCsv(stream);
+	return static_cast<bool>(stream);
+}
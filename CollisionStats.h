@@ -0,0 +1,54 @@
+#pragma once
+
+#include <iosfwd>
+#include <vector>
+
+//counts of one CollisionManager::Update, including the moves, registrations and queries since the previous one.
+//CollisionManager::GetPairTestCount adds up broadphaseTests and the narrowphase tests of pairs without a bounding circle test
+//(unindexed shapes, static shapes on a single detection thread), a narrowphase test after a bounding circle test is not a second pair test
+struct CollisionFrameStats
+{
+	long long frame = 0;
+	int shapeCount = 0; //registered at the end of the frame, static ones included
+
+	long long broadphaseTests = 0; //bounding circle tests of the batch kernels and the rebuilt backends
+	long long candidatePairs = 0; //pairs handed to the narrowphase
+	long long narrowphaseTests = 0; //exact shape tests, circle pairs are already exact from the broadphase
+	long long overlaps = 0; //contacts reported, see CollisionManager::GetContacts
+
+	long long nodeVisits = 0; //QuadTree nodes walked by inserts, relocations, detection and queries
+	int subdivisions = 0;
+	int merges = 0;
+	long long reinsertions = 0; //entries moved to another quarter by their position or a reinsert of the whole tree
+	long long entryLookups = 0; //CollisionManager::FindCollisionEntryById calls
+
+	int allocations = 0; //reallocations of the collision core's containers, sampled at the end of the frame
+};
+
+//ring buffer of the last frames' stats, oldest frames are overwritten.
+//written as JSON lines (one object per frame) or CSV with a header row, oldest frame first
+class CollisionStatsRecorder
+{
+public:
+	explicit CollisionStatsRecorder(int capacity = 600);
+
+	void Push(const CollisionFrameStats& stats);
+	void Clear();
+
+	int GetCount() const { return m_count; }
+	int GetCapacity() const { return static_cast<int>(m_frames.size()); }
+	//0 is the oldest frame held
+	const CollisionFrameStats& GetFrame(int index) const;
+
+	void WriteJsonLines(std::ostream& stream) const;
+	void WriteCsv(std::ostream& stream) const;
+	//false if the file can not be opened
+	bool WriteJsonLines(const char* path) const;
+	bool WriteCsv(const char* path) const;
+
+private:
+
+	std::vector<CollisionFrameStats> m_frames;
+	int m_next = 0;
+	int m_count = 0;
+};
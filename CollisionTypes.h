@@ -0,0 +1,218 @@
+#pragma once
+
+//shape and entry types shared by the CollisionManager and its broadphase backends
+
+#include <SFML/System/Vector2.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+struct CollisionEntry;
+class Entity;
+
+using TCollisionCallbackSignature = std::function<void(const CollisionEntry&, const CollisionEntry&, sf::Vector2f)>;
+
+//overlap state changes of a pair, reported once per Update from the pair cache (see CollisionManager::SetCollisionEvents)
+enum class ECollisionEventType
+{
+	Enter,	//first Update the pair overlaps
+	Stay,	//every further Update it still overlaps
+	Exit	//first Update it does not overlap anymore, otherId may already be unregistered
+};
+
+enum ECollisionEventFlags : uint8_t
+{
+	COLLISION_EVENT_ENTER = 1 << 0,
+	COLLISION_EVENT_STAY = 1 << 1,
+	COLLISION_EVENT_EXIT = 1 << 2
+};
+
+using TCollisionEventSignature = std::function<void(ECollisionEventType type, int selfId, int otherId)>;
+
+enum class EShapeType
+{
+	Circle,
+	Box
+};
+
+struct CollisionShape
+{
+	EShapeType type = EShapeType::Circle;
+	float radius = 0.f;
+	float width = 0.f;
+	float height = 0.f;
+};
+
+struct CollisionAABB
+{
+	sf::Vector2f min;
+	sf::Vector2f max;
+
+	static CollisionAABB Empty() { return { sf::Vector2f(FLT_MAX, FLT_MAX), sf::Vector2f(-FLT_MAX, -FLT_MAX) }; }
+
+	bool IsEmpty() const { return min.x > max.x; }
+	bool Intersects(const CollisionAABB& other) const
+	{
+		return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y;
+	}
+	bool Contains(const CollisionAABB& other) const
+	{
+		return min.x <= other.min.x && max.x >= other.max.x && min.y <= other.min.y && max.y >= other.max.y;
+	}
+	void Merge(const CollisionAABB& other)
+	{
+		min.x = std::min(min.x, other.min.x);
+		min.y = std::min(min.y, other.min.y);
+		max.x = std::max(max.x, other.max.x);
+		max.y = std::max(max.y, other.max.y);
+	}
+	//where the segment origin + t * delta enters the box (0 if origin is inside), false if it misses it before maxFraction
+	bool IntersectsSegment(sf::Vector2f origin, sf::Vector2f delta, float maxFraction, float& outEnter) const
+	{
+		float enter = 0.f;
+		float exit = maxFraction;
+		const float origins[2] = { origin.x, origin.y };
+		const float deltas[2] = { delta.x, delta.y };
+		const float mins[2] = { min.x, min.y };
+		const float maxs[2] = { max.x, max.y };
+
+		for (int axis = 0; axis < 2; axis++)
+		{
+			if (deltas[axis] == 0.f)
+			{
+				if (origins[axis] < mins[axis] || origins[axis] > maxs[axis])
+					return false;
+				continue;
+			}
+
+			const float t0 = (mins[axis] - origins[axis]) / deltas[axis];
+			const float t1 = (maxs[axis] - origins[axis]) / deltas[axis];
+			enter = std::max(enter, std::min(t0, t1));
+			exit = std::min(exit, std::max(t0, t1));
+			if (enter > exit)
+				return false;
+		}
+
+		outEnter = enter;
+		return true;
+	}
+	//distance from point to the box, 0 inside
+	float GetDistance(sf::Vector2f point) const
+	{
+		const float dx = std::max(std::max(min.x - point.x, point.x - max.x), 0.f);
+		const float dy = std::max(std::max(min.y - point.y, point.y - max.y), 0.f);
+		return std::sqrt(dx * dx + dy * dy);
+	}
+};
+
+//how RegisterShape puts a shape into the spatial index
+enum class ECollisionIndexPolicy
+{
+	Auto,		//indexed; static shapes in the static index (see StaticCollisionIndex), moving ones in the QuadTree:
+				//small circles by their center point, boxes and large circles by their bounds
+	Bounds,		//indexed by bounds: stored in the deepest quarter whose loose cell contains the AABB
+	Unindexed	//kept out of the index, queries the index with its AABB every update and tests all other unindexed shapes
+};
+
+//plain data, the callbacks of a shape live in a side table of the CollisionManager
+struct CollisionEntry
+{
+	int id = 0;
+	bool isIndexedByBounds = false; //from the index policy at registration, see CollisionManager::IsIndexedByBounds
+	bool isDeleted = false;
+	bool isStatic = false;
+
+	sf::Vector2f position;
+	sf::Vector2f previousPosition; //where the sweep of a swept shape starts, its position at the end of the last Update
+	CollisionShape shape;
+
+	bool isTriggerVolume = true;
+	bool isSwept = false; //see CollisionManager::SetShapeSwept
+	bool hasCallback = false; //registered with a per shape callback, see CollisionManager::DispatchContactCallbacks
+	uint8_t eventMask = 0; //ECollisionEventFlags the event callback gets, 0 keeps the shape's pairs out of the pair cache
+
+	int QTNodeIndex = -1;
+	int QTNodeQuater = 0;
+
+	Entity* pEntity = nullptr;
+
+};
+
+static_assert(std::is_trivially_copyable<CollisionEntry>::value, "CollisionEntry is moved around by swap-and-pop and copied into jobs");
+
+//confirmed overlap of one Update, appended during detection (see CollisionManager::GetContacts)
+struct CollisionContactRecord
+{
+	int lhsId = 0;
+	int rhsId = 0;
+	Entity* pLhsEntity = nullptr;
+	Entity* pRhsEntity = nullptr;
+	sf::Vector2f resolveVectorLhs; //how far resolving moved each side
+	sf::Vector2f resolveVectorRhs;
+};
+
+enum ECollisionEntryFlags : uint8_t
+{
+	COLLISION_FLAG_DELETED = 1 << 0,
+	COLLISION_FLAG_STATIC = 1 << 1,
+	COLLISION_FLAG_TRIGGER = 1 << 2,
+	COLLISION_FLAG_BOX = 1 << 3,	//radius is the bounding radius, pairs need the shape test
+	COLLISION_FLAG_BOUNDS = 1 << 4,	//indexed by bounds, see ECollisionIndexPolicy
+	COLLISION_FLAG_SWEPT = 1 << 5	//x / y / radius bound the path of this Update, pairs need the swept test
+};
+
+//the SoA circle only bounds the shape, overlaps of it are candidates for the shape test
+constexpr uint8_t COLLISION_FLAGS_SHAPE_TEST = COLLISION_FLAG_BOX | COLLISION_FLAG_SWEPT;
+
+//hot narrowphase data of the QT entries (structure of arrays), same order as m_shapes_QT
+struct CollisionEntrySoA
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> radius;
+	std::vector<uint8_t> flags;
+
+	void Push(const CollisionEntry& entry);
+	//recomputes the hot data of index from the entry
+	void Set(size_t index, const CollisionEntry& entry);
+	void RemoveAt(size_t index);
+	void SetPosition(size_t index, sf::Vector2f position) { x[index] = position.x; y[index] = position.y; }
+	size_t Size() const { return x.size(); }
+};
+
+//candidate / overlapping pair, dense indices into m_shapes_QT
+struct CollisionPair
+{
+	int lhs = 0;
+	int rhs = 0;
+};
+
+//pair found overlapping by the detection phase, resolved later on the calling thread.
+//no normal or depth: earlier contacts of the same frame may move either side before this one is resolved
+struct CollisionContact
+{
+	int lhsId = 0;
+	int rhsId = 0;
+};
+
+//segment cast through the shapes, see CollisionManager::RaycastBatch
+struct CollisionRay
+{
+	sf::Vector2f origin;
+	sf::Vector2f end;
+	int ignoreId = 0; //e.g. the shooter's own shape
+};
+
+//nearest hit of a ray, id 0 if nothing was hit
+struct CollisionRayHit
+{
+	int id = 0;
+	float fraction = 1.f; //along origin -> end, 0 if the origin is inside the shape
+	sf::Vector2f point;
+	sf::Vector2f normal; //surface normal at point, against the ray for hits at fraction 0
+};
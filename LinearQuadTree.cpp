@@ -0,0 +1,250 @@
+#include "LinearQuadTree.h"
+
+#include "CollisionKernels.h"
+
+#include <algorithm>
+#include <cassert>
+
+uint32_t LinearQuadTree::SpreadBits(uint32_t value)
+{
+	//16 bit -> every other bit of 32
+	value &= 0x0000ffff;
+	value = (value | (value << 8)) & 0x00ff00ff;
+	value = (value | (value << 4)) & 0x0f0f0f0f;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+void LinearQuadTree::Build(const CollisionEntrySoA& shapes, const CollisionAABB& worldBounds)
+{
+	assert(m_config.maxDepth >= 1 && m_config.maxDepth <= 16);
+
+	m_codes.clear();
+	m_denseIndices.clear();
+
+	const int count = static_cast<int>(shapes.Size());
+
+	//rebuilt anyway, so the grid can follow shapes that left the world instead of clamping them into one border cell
+	CollisionAABB bounds = worldBounds;
+	for (int i = 0; i < count; i++)
+	{
+		if (shapes.flags[i] & COLLISION_FLAG_DELETED)
+			continue;
+
+		bounds.min.x = std::min(bounds.min.x, shapes.x[i]);
+		bounds.min.y = std::min(bounds.min.y, shapes.y[i]);
+		bounds.max.x = std::max(bounds.max.x, shapes.x[i]);
+		bounds.max.y = std::max(bounds.max.y, shapes.y[i]);
+	}
+
+	const sf::Vector2f worldSize = bounds.max - bounds.min;
+	const float cellsPerAxis = 65536.f;
+	const float scaleX = worldSize.x > 0.f ? cellsPerAxis / worldSize.x : 0.f;
+	const float scaleY = worldSize.y > 0.f ? cellsPerAxis / worldSize.y : 0.f;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (shapes.flags[i] & COLLISION_FLAG_DELETED)
+			continue;
+
+		const float cellX = std::clamp((shapes.x[i] - bounds.min.x) * scaleX, 0.f, cellsPerAxis - 1.f);
+		const float cellY = std::clamp((shapes.y[i] - bounds.min.y) * scaleY, 0.f, cellsPerAxis - 1.f);
+
+		//y in the odd bits: quadrant order per level is nw, ne, sw, se
+		m_codes.push_back(SpreadBits(static_cast<uint32_t>(cellX)) | (SpreadBits(static_cast<uint32_t>(cellY)) << 1));
+		m_denseIndices.push_back(i);
+	}
+
+	SortByCode();
+
+	//gather the hot data in sorted order, leaves become contiguous ranges
+	const int sortedCount = static_cast<int>(m_codes.size());
+	m_x.resize(sortedCount);
+	m_y.resize(sortedCount);
+	m_radius.resize(sortedCount);
+	for (int i = 0; i < sortedCount; i++)
+	{
+		const int denseIndex = m_denseIndices[i];
+		m_x[i] = shapes.x[denseIndex];
+		m_y[i] = shapes.y[denseIndex];
+		m_radius[i] = shapes.radius[denseIndex];
+	}
+
+	BuildNodes();
+}
+
+void LinearQuadTree::SortByCode()
+{
+	//LSD radix sort, 4 passes of 8 bits
+	const size_t count = m_codes.size();
+	m_codesScratch.resize(count);
+	m_denseIndicesScratch.resize(count);
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		size_t offsets[257] = {};
+		for (size_t i = 0; i < count; i++)
+		{
+			offsets[((m_codes[i] >> shift) & 0xff) + 1]++;
+		}
+
+		//all codes share this digit, nothing to move
+		if (offsets[((m_codes.empty() ? 0 : m_codes[0] >> shift) & 0xff) + 1] == count)
+			continue;
+
+		for (int digit = 0; digit < 256; digit++)
+		{
+			offsets[digit + 1] += offsets[digit];
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const size_t target = offsets[(m_codes[i] >> shift) & 0xff]++;
+			m_codesScratch[target] = m_codes[i];
+			m_denseIndicesScratch[target] = m_denseIndices[i];
+		}
+
+		m_codes.swap(m_codesScratch);
+		m_denseIndices.swap(m_denseIndicesScratch);
+	}
+}
+
+void LinearQuadTree::BuildNodes()
+{
+	m_nodes.clear();
+	m_leafCount = 0;
+
+	Node root;
+	root.end = static_cast<int>(m_codes.size());
+	m_nodes.push_back(root);
+
+	//preorder, children always come after their parent
+	m_nodeStack.clear();
+	m_nodeStack.push_back(0);
+	while (!m_nodeStack.empty())
+	{
+		const int nodeIndex = m_nodeStack.back();
+		m_nodeStack.pop_back();
+
+		const Node node = m_nodes[nodeIndex];
+		if (node.end - node.begin <= m_config.leafCapacity || node.depth >= m_config.maxDepth)
+		{
+			m_leafCount++;
+			continue;
+		}
+
+		const int childDepth = node.depth + 1;
+		const int shift = 32 - 2 * childDepth;
+		int begin = node.begin;
+		for (uint32_t quadrant = 0; quadrant < 4; quadrant++)
+		{
+			const uint32_t childPrefix = (node.prefix << 2) | quadrant;
+			const uint64_t childEndCode = (static_cast<uint64_t>(childPrefix) + 1) << shift;
+
+			const int end = static_cast<int>(std::lower_bound(m_codes.begin() + begin, m_codes.begin() + node.end, childEndCode,
+				[](uint32_t code, uint64_t value) { return code < value; }) - m_codes.begin());
+
+			if (end > begin)
+			{
+				Node child;
+				child.begin = begin;
+				child.end = end;
+				child.depth = childDepth;
+				child.prefix = childPrefix;
+
+				m_nodes[nodeIndex].children[quadrant] = static_cast<int>(m_nodes.size());
+				m_nodeStack.push_back(static_cast<int>(m_nodes.size()));
+				m_nodes.push_back(child);
+			}
+
+			begin = end;
+		}
+	}
+
+	//bounds bottom-up, reverse preorder visits children before parents
+	for (int nodeIndex = static_cast<int>(m_nodes.size()) - 1; nodeIndex >= 0; nodeIndex--)
+	{
+		Node& node = m_nodes[nodeIndex];
+		node.bounds = CollisionAABB::Empty();
+
+		if (node.IsLeaf())
+		{
+			for (int i = node.begin; i < node.end; i++)
+			{
+				node.bounds.Merge({ sf::Vector2f(m_x[i] - m_radius[i], m_y[i] - m_radius[i]), sf::Vector2f(m_x[i] + m_radius[i], m_y[i] + m_radius[i]) });
+			}
+		}
+		else
+		{
+			for (int child : node.children)
+			{
+				if (child != -1)
+					node.bounds.Merge(m_nodes[child].bounds);
+			}
+		}
+	}
+}
+
+void LinearQuadTree::GeneratePairs(std::vector<CollisionPair>& outPairs)
+{
+	outPairs.clear();
+	m_pairTestCount = 0;
+
+	if (m_kernelHits.size() < m_codes.size())
+		m_kernelHits.resize(m_codes.size());
+
+	for (const Node& leaf : m_nodes)
+	{
+		if (!leaf.IsLeaf())
+			continue;
+
+		for (int i = leaf.begin; i < leaf.end; i++)
+		{
+			//inside the leaf
+			TestAgainstRange(i, i + 1, leaf.end, outPairs);
+
+			//leaves further along the curve whose bounds overlap, each pair is found from the earlier leaf only
+			const CollisionAABB bounds = { sf::Vector2f(m_x[i] - m_radius[i], m_y[i] - m_radius[i]), sf::Vector2f(m_x[i] + m_radius[i], m_y[i] + m_radius[i]) };
+
+			m_nodeStack.clear();
+			m_nodeStack.push_back(0);
+			while (!m_nodeStack.empty())
+			{
+				const Node& node = m_nodes[m_nodeStack.back()];
+				m_nodeStack.pop_back();
+
+				if (node.end <= leaf.end || !node.bounds.Intersects(bounds))
+					continue;
+
+				if (node.IsLeaf())
+				{
+					TestAgainstRange(i, node.begin, node.end, outPairs);
+					continue;
+				}
+
+				for (int child : node.children)
+				{
+					if (child != -1)
+						m_nodeStack.push_back(child);
+				}
+			}
+		}
+	}
+}
+
+void LinearQuadTree::TestAgainstRange(int sortedIndex, int begin, int end, std::vector<CollisionPair>& outPairs)
+{
+	const int count = end - begin;
+	if (count <= 0)
+		return;
+
+	m_pairTestCount += count;
+	const int hitCount = CollisionKernels::TestCircleBatch(m_x[sortedIndex], m_y[sortedIndex], m_radius[sortedIndex],
+		m_x.data() + begin, m_y.data() + begin, m_radius.data() + begin, count, m_kernelHits.data());
+
+	for (int i = 0; i < hitCount; i++)
+	{
+		outPairs.push_back({ m_denseIndices[sortedIndex], m_denseIndices[begin + m_kernelHits[i]] });
+	}
+}
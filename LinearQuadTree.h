@@ -0,0 +1,71 @@
+#pragma once
+
+#include "BroadphaseBackend.h"
+
+#include <cstdint>
+#include <vector>
+
+//Linear (Morton ordered) quadtree, rebuilt from scratch every frame.
+//Build() quantizes the positions to Morton codes, radix sorts them and derives the
+//nodes as contiguous ranges of the sorted order; no per-entry bookkeeping when things move.
+//Pairs are generated with loose semantics: every node carries the bounds of its shapes,
+//so shapes straddling a cell border are found like in EQuadTreeBoundsMode::Loose.
+class LinearQuadTree : public BroadphaseBackend
+{
+public:
+	struct Config
+	{
+		int leafCapacity = 8;
+		int maxDepth = 8; //<= 16, 2 bits per level in a 32 bit code
+	};
+
+	void SetConfig(const Config& config) { m_config = config; }
+	const Config& GetConfig() const { return m_config; }
+
+	//the cells span the world bounds grown over the live shapes, so entries far outside the world still spread over the tree
+	void Build(const CollisionEntrySoA& shapes, const CollisionAABB& worldBounds) override;
+
+	void GeneratePairs(std::vector<CollisionPair>& outPairs) override;
+
+	int GetNodeCount() const override { return static_cast<int>(m_nodes.size()); }
+	int GetLeafCount() const { return m_leafCount; }
+	long long GetPairTestCount() const override { return m_pairTestCount; }
+
+private:
+
+	struct Node
+	{
+		int begin = 0;
+		int end = 0;
+		int depth = 0;
+		uint32_t prefix = 0;
+		int children[4] = { -1, -1, -1, -1 };
+		CollisionAABB bounds;
+
+		bool IsLeaf() const { return children[0] == -1 && children[1] == -1 && children[2] == -1 && children[3] == -1; }
+	};
+
+	static uint32_t SpreadBits(uint32_t value);
+	void SortByCode();
+	void BuildNodes();
+	void TestAgainstRange(int sortedIndex, int begin, int end, std::vector<CollisionPair>& outPairs);
+
+	Config m_config;
+
+	//sorted by Morton code
+	std::vector<uint32_t> m_codes;
+	std::vector<int> m_denseIndices;
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_radius;
+
+	//radix sort double buffers
+	std::vector<uint32_t> m_codesScratch;
+	std::vector<int> m_denseIndicesScratch;
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_nodeStack;
+	std::vector<int> m_kernelHits;
+	int m_leafCount = 0;
+	long long m_pairTestCount = 0;
+};
@@ -0,0 +1,240 @@
+#include "SpatialHashGrid.h"
+
+#include "CollisionKernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+void SpatialHashGrid::Build(const CollisionEntrySoA& shapes, const CollisionAABB& worldBounds)
+{
+	assert(m_config.cellSize >= 0.f && m_config.cellSizePercentile >= 0.f && m_config.cellSizePercentile <= 1.f);
+
+	m_origin = worldBounds.min;
+	m_cellSize = m_config.cellSize > 0.f ? m_config.cellSize : FitCellSize(shapes);
+	m_inverseCellSize = 1.f / m_cellSize;
+
+	const int count = static_cast<int>(shapes.Size());
+
+	//at most half full, probes stay short
+	size_t capacity = 16;
+	while (capacity < 2 * static_cast<size_t>(count))
+	{
+		capacity <<= 1;
+	}
+	m_tableKeys.resize(capacity);
+	m_tableCells.assign(capacity, -1);
+	m_tableMask = capacity - 1;
+
+	m_cellX.clear();
+	m_cellY.clear();
+	m_cellStart.clear();
+	m_shapeCells.resize(count);
+
+	//counting pass
+	const float maxCellRadius = 0.5f * m_cellSize;
+	int oversizedCount = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (shapes.flags[i] & COLLISION_FLAG_DELETED)
+		{
+			m_shapeCells[i] = DELETED_CELL;
+			continue;
+		}
+
+		if (shapes.radius[i] > maxCellRadius)
+		{
+			m_shapeCells[i] = OVERSIZED_CELL;
+			oversizedCount++;
+			continue;
+		}
+
+		const int cell = FindOrAddCell(GetCellCoordinate(shapes.x[i], m_origin.x), GetCellCoordinate(shapes.y[i], m_origin.y));
+		m_shapeCells[i] = cell;
+		m_cellStart[cell]++;
+	}
+
+	//counts -> first sorted index per cell, the extra element ends the last cell
+	m_cellStart.push_back(0);
+	int offset = 0;
+	for (int& start : m_cellStart)
+	{
+		const int cellCount = start;
+		start = offset;
+		offset += cellCount;
+	}
+
+	m_oversizedBegin = offset;
+	const int sortedCount = offset + oversizedCount;
+	m_denseIndices.resize(sortedCount);
+	m_x.resize(sortedCount);
+	m_y.resize(sortedCount);
+	m_radius.resize(sortedCount);
+
+	//scatter pass, advances every start to the end of its cell
+	int oversizedCursor = m_oversizedBegin;
+	for (int i = 0; i < count; i++)
+	{
+		const int cell = m_shapeCells[i];
+		if (cell == DELETED_CELL)
+			continue;
+
+		const int target = cell == OVERSIZED_CELL ? oversizedCursor++ : m_cellStart[cell]++;
+		m_denseIndices[target] = i;
+		m_x[target] = shapes.x[i];
+		m_y[target] = shapes.y[i];
+		m_radius[target] = shapes.radius[i];
+	}
+
+	//the end of a cell is the start of the next one
+	for (size_t cell = m_cellX.size(); cell > 0; cell--)
+	{
+		m_cellStart[cell] = m_cellStart[cell - 1];
+	}
+	m_cellStart[0] = 0;
+}
+
+float SpatialHashGrid::FitCellSize(const CollisionEntrySoA& shapes)
+{
+	m_radiusScratch.clear();
+	for (size_t i = 0; i < shapes.Size(); i++)
+	{
+		if (!(shapes.flags[i] & COLLISION_FLAG_DELETED))
+			m_radiusScratch.push_back(shapes.radius[i]);
+	}
+
+	if (m_radiusScratch.empty())
+		return 1.f;
+
+	const size_t index = std::min(m_radiusScratch.size() - 1, static_cast<size_t>(m_config.cellSizePercentile * m_radiusScratch.size()));
+	std::nth_element(m_radiusScratch.begin(), m_radiusScratch.begin() + index, m_radiusScratch.end());
+
+	const float diameter = 2.f * m_radiusScratch[index];
+	return diameter > 0.f ? diameter : 1.f;
+}
+
+int SpatialHashGrid::FindOrAddCell(int cellX, int cellY)
+{
+	const uint64_t key = GetCellKey(cellX, cellY);
+	uint64_t slot = HashCellKey(key) & m_tableMask;
+	while (m_tableCells[slot] != -1)
+	{
+		if (m_tableKeys[slot] == key)
+			return m_tableCells[slot];
+
+		slot = (slot + 1) & m_tableMask;
+	}
+
+	const int cell = static_cast<int>(m_cellX.size());
+	m_tableKeys[slot] = key;
+	m_tableCells[slot] = cell;
+	m_cellX.push_back(cellX);
+	m_cellY.push_back(cellY);
+	m_cellStart.push_back(0);
+	return cell;
+}
+
+int SpatialHashGrid::FindCell(int cellX, int cellY) const
+{
+	const uint64_t key = GetCellKey(cellX, cellY);
+	uint64_t slot = HashCellKey(key) & m_tableMask;
+	while (m_tableCells[slot] != -1)
+	{
+		if (m_tableKeys[slot] == key)
+			return m_tableCells[slot];
+
+		slot = (slot + 1) & m_tableMask;
+	}
+	return -1;
+}
+
+int SpatialHashGrid::GetCellCoordinate(float position, float origin) const
+{
+	//far out positions share the border cells instead of overflowing the int
+	const float cell = std::floor((position - origin) * m_inverseCellSize);
+	return static_cast<int>(std::clamp(cell, -1073741824.f, 1073741824.f));
+}
+
+void SpatialHashGrid::GeneratePairs(std::vector<CollisionPair>& outPairs)
+{
+	outPairs.clear();
+	m_pairTestCount = 0;
+
+	if (m_kernelHits.size() < m_x.size())
+		m_kernelHits.resize(m_x.size());
+
+	//the forward half of the 8 neighbours, every pair of cells is visited from one side only
+	const int neighbourOffsets[4][2] = { { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+
+	const int cellCount = GetCellCount();
+	for (int cell = 0; cell < cellCount; cell++)
+	{
+		const int begin = m_cellStart[cell];
+		const int end = m_cellStart[cell + 1];
+
+		//inside the cell
+		for (int i = begin; i < end; i++)
+		{
+			TestAgainstRange(i, i + 1, end, outPairs);
+		}
+
+		for (const int* offset : neighbourOffsets)
+		{
+			const int neighbour = FindCell(m_cellX[cell] + offset[0], m_cellY[cell] + offset[1]);
+			if (neighbour == -1)
+				continue;
+
+			for (int i = begin; i < end; i++)
+			{
+				TestAgainstRange(i, m_cellStart[neighbour], m_cellStart[neighbour + 1], outPairs);
+			}
+		}
+	}
+
+	//oversized shapes against each other and against the cells their bounds reach into,
+	//shapes in the cells reach up to half a cell out of theirs
+	const int sortedCount = static_cast<int>(m_x.size());
+	for (int i = m_oversizedBegin; i < sortedCount; i++)
+	{
+		TestAgainstRange(i, i + 1, sortedCount, outPairs);
+
+		const float reach = m_radius[i] + 0.5f * m_cellSize;
+		const int minX = GetCellCoordinate(m_x[i] - reach, m_origin.x);
+		const int minY = GetCellCoordinate(m_y[i] - reach, m_origin.y);
+		const int maxX = GetCellCoordinate(m_x[i] + reach, m_origin.x);
+		const int maxY = GetCellCoordinate(m_y[i] + reach, m_origin.y);
+
+		//covering more cells than are occupied, a single batch over all of them is cheaper than the lookups
+		if (static_cast<long long>(maxX - minX + 1) * (maxY - minY + 1) > cellCount)
+		{
+			TestAgainstRange(i, 0, m_oversizedBegin, outPairs);
+			continue;
+		}
+
+		for (int cellY = minY; cellY <= maxY; cellY++)
+		{
+			for (int cellX = minX; cellX <= maxX; cellX++)
+			{
+				const int cell = FindCell(cellX, cellY);
+				if (cell != -1)
+					TestAgainstRange(i, m_cellStart[cell], m_cellStart[cell + 1], outPairs);
+			}
+		}
+	}
+}
+
+void SpatialHashGrid::TestAgainstRange(int sortedIndex, int begin, int end, std::vector<CollisionPair>& outPairs)
+{
+	const int count = end - begin;
+	if (count <= 0)
+		return;
+
+	m_pairTestCount += count;
+	const int hitCount = CollisionKernels::TestCircleBatch(m_x[sortedIndex], m_y[sortedIndex], m_radius[sortedIndex],
+		m_x.data() + begin, m_y.data() + begin, m_radius.data() + begin, count, m_kernelHits.data());
+
+	for (int i = 0; i < hitCount; i++)
+	{
+		outPairs.push_back({ m_denseIndices[sortedIndex], m_denseIndices[begin + m_kernelHits[i]] });
+	}
+}
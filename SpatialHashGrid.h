@@ -0,0 +1,78 @@
+#pragma once
+
+#include "BroadphaseBackend.h"
+
+#include <cstdint>
+#include <vector>
+
+//Uniform spatial hash grid, rebuilt from scratch every frame.
+//Build() hashes every shape's center cell into an open addressing table and counting sorts the shapes by cell,
+//so every occupied cell is a contiguous range; no tree, no per-entry bookkeeping when things move.
+//With the cell size at least the largest diameter, pairs only come from a cell and its 8 neighbours.
+//Shapes larger than a cell (big boxes, long sweeps) are kept aside and query the cells their bounds cover.
+class SpatialHashGrid : public BroadphaseBackend
+{
+public:
+	struct Config
+	{
+		float cellSize = 0.f; //0: fitted every Build, the diameter of the shape at cellSizePercentile
+		float cellSizePercentile = 0.9f; //the larger shapes are oversized
+	};
+
+	void SetConfig(const Config& config) { m_config = config; }
+	const Config& GetConfig() const { return m_config; }
+
+	//the world bounds only anchor the cell coordinates, the grid itself is unbounded
+	void Build(const CollisionEntrySoA& shapes, const CollisionAABB& worldBounds) override;
+	void GeneratePairs(std::vector<CollisionPair>& outPairs) override;
+
+	int GetNodeCount() const override { return GetCellCount(); }
+	long long GetPairTestCount() const override { return m_pairTestCount; }
+
+	int GetCellCount() const { return static_cast<int>(m_cellX.size()); }
+	int GetOversizedCount() const { return static_cast<int>(m_x.size()) - m_oversizedBegin; }
+	float GetCellSize() const { return m_cellSize; }
+
+private:
+
+	static constexpr int DELETED_CELL = -1;
+	static constexpr int OVERSIZED_CELL = -2;
+
+	float FitCellSize(const CollisionEntrySoA& shapes);
+	static uint64_t GetCellKey(int cellX, int cellY) { return (static_cast<uint64_t>(static_cast<uint32_t>(cellX)) << 32) | static_cast<uint32_t>(cellY); }
+	//fibonacci hashing, neighbouring cells land far apart in the table
+	static uint64_t HashCellKey(uint64_t key) { return (key * 0x9E3779B97F4A7C15ull) >> 24; }
+	int FindOrAddCell(int cellX, int cellY);
+	int FindCell(int cellX, int cellY) const;
+	int GetCellCoordinate(float position, float origin) const;
+	void TestAgainstRange(int sortedIndex, int begin, int end, std::vector<CollisionPair>& outPairs);
+
+	Config m_config;
+	float m_cellSize = 1.f;
+	float m_inverseCellSize = 1.f;
+	sf::Vector2f m_origin;
+
+	//open addressing, linear probing. cell index per slot, -1 is empty
+	std::vector<uint64_t> m_tableKeys;
+	std::vector<int> m_tableCells;
+	uint64_t m_tableMask = 0;
+
+	//per occupied cell, in order of first occurrence
+	std::vector<int> m_cellX;
+	std::vector<int> m_cellY;
+	std::vector<int> m_cellStart; //first sorted index, one more element ends the last cell
+
+	//per shape in the SoA order of Build, the cell, DELETED_CELL or OVERSIZED_CELL
+	std::vector<int> m_shapeCells;
+
+	//sorted by cell, the oversized shapes follow the last cell
+	std::vector<int> m_denseIndices;
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_radius;
+	int m_oversizedBegin = 0;
+
+	std::vector<float> m_radiusScratch;
+	std::vector<int> m_kernelHits;
+	long long m_pairTestCount = 0;
+};
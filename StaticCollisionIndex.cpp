@@ -0,0 +1,128 @@
+#include "StaticCollisionIndex.h"
+#include "CollisionManager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+void StaticCollisionIndex::Clear()
+{
+	m_nodes.clear();
+	m_levelBegin.clear();
+	m_ids.clear();
+	m_minX.clear();
+	m_minY.clear();
+	m_maxX.clear();
+	m_maxY.clear();
+}
+
+void StaticCollisionIndex::Build(const std::vector<CollisionEntry>& shapes)
+{
+	Clear();
+
+	m_levelBounds.clear();
+	for (const CollisionEntry& entry : shapes)
+	{
+		if (entry.isDeleted)
+			continue;
+
+		m_ids.push_back(entry.id);
+		m_levelBounds.push_back(CollisionManager::GetEntryAABB(entry));
+	}
+
+	if (m_ids.empty())
+		return;
+
+	//leaves: the shapes in packing order, s_nodeCapacity per leaf
+	SortTileRecursive(m_levelBounds, m_order);
+
+	const std::vector<int> ids = m_ids;
+	for (int i = 0; i < static_cast<int>(m_order.size()); i++)
+	{
+		const CollisionAABB& bounds = m_levelBounds[m_order[i]];
+
+		m_ids[i] = ids[m_order[i]];
+		m_minX.push_back(bounds.min.x);
+		m_minY.push_back(bounds.min.y);
+		m_maxX.push_back(bounds.max.x);
+		m_maxY.push_back(bounds.max.y);
+	}
+
+	int childCount = static_cast<int>(m_ids.size());
+	m_levelBegin.push_back(0);
+	for (int first = 0; first < childCount; first += s_nodeCapacity)
+	{
+		Node& node = m_nodes.emplace_back();
+		node.first = first;
+		node.count = std::min(s_nodeCapacity, childCount - first);
+		node.bounds = CollisionAABB::Empty();
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			node.bounds.Merge(GetShapeBounds(i));
+		}
+	}
+
+	//every further level packs the one below until a single root is left.
+	//the level below is reordered in place, its own children stay where they are
+	while (static_cast<int>(m_nodes.size()) - m_levelBegin.back() > 1)
+	{
+		const int levelBegin = m_levelBegin.back();
+		childCount = static_cast<int>(m_nodes.size()) - levelBegin;
+
+		m_levelBounds.clear();
+		m_levelNodes.assign(m_nodes.begin() + levelBegin, m_nodes.end());
+		for (const Node& node : m_levelNodes)
+		{
+			m_levelBounds.push_back(node.bounds);
+		}
+
+		SortTileRecursive(m_levelBounds, m_order);
+		for (int i = 0; i < childCount; i++)
+		{
+			m_nodes[levelBegin + i] = m_levelNodes[m_order[i]];
+		}
+
+		m_levelBegin.push_back(static_cast<int>(m_nodes.size()));
+		for (int first = 0; first < childCount; first += s_nodeCapacity)
+		{
+			Node node;
+			node.first = levelBegin + first;
+			node.count = std::min(s_nodeCapacity, childCount - first);
+			node.bounds = CollisionAABB::Empty();
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				node.bounds.Merge(m_nodes[i].bounds);
+			}
+			m_nodes.push_back(node);
+		}
+	}
+
+	assert(m_nodes.size() - m_levelBegin.back() == 1);
+}
+
+void StaticCollisionIndex::SortTileRecursive(const std::vector<CollisionAABB>& bounds, std::vector<int>& outOrder) const
+{
+	const int count = static_cast<int>(bounds.size());
+
+	outOrder.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		outOrder[i] = i;
+	}
+
+	auto centerX = [&bounds](int i) { return bounds[i].min.x + bounds[i].max.x; };
+	auto centerY = [&bounds](int i) { return bounds[i].min.y + bounds[i].max.y; };
+
+	//sqrt(node count) vertical slices of sqrt(node count) full nodes each
+	const int nodeCount = (count + s_nodeCapacity - 1) / s_nodeCapacity;
+	const int sliceCount = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(nodeCount))));
+	const int sliceSize = ((nodeCount + sliceCount - 1) / sliceCount) * s_nodeCapacity;
+
+	std::sort(outOrder.begin(), outOrder.end(), [&](int lhs, int rhs) { return centerX(lhs) < centerX(rhs); });
+
+	for (int begin = 0; begin < count; begin += sliceSize)
+	{
+		const int end = std::min(count, begin + sliceSize);
+		std::sort(outOrder.begin() + begin, outOrder.begin() + end, [&](int lhs, int rhs) { return centerY(lhs) < centerY(rhs); });
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "CollisionKernels.h"
+#include "CollisionTypes.h"
+
+#include <vector>
+
+//read-only index over the shapes that never move (walls, level geometry).
+//Build() bulk loads an R-tree with sort-tile-recursive packing: every node is full except the last of a level,
+//nodes are stored level by level and the children of a node are contiguous, so there are no per-node allocations.
+//the shape bounds of a leaf are stored as structure of arrays and tested in one CollisionKernels::TestBoxBatch call.
+//the index is not updated incrementally, any change to the static shapes means another Build()
+class StaticCollisionIndex
+{
+public:
+	//replaces the contents with every live shape of the list
+	void Build(const std::vector<CollisionEntry>& shapes);
+	void Clear();
+
+	bool IsEmpty() const { return m_nodes.empty(); }
+	int GetShapeCount() const { return static_cast<int>(m_ids.size()); }
+	int GetNodeCount() const { return static_cast<int>(m_nodes.size()); }
+	const CollisionAABB& GetBounds() const { return m_nodes.back().bounds; }
+
+	//calls visitor(id) for every shape whose AABB overlaps bounds. recursive, allocates nothing
+	template<typename TVisitor>
+	void Query(const CollisionAABB& bounds, TVisitor&& visitor) const;
+
+	//calls visitor(id) for every shape whose AABB the segment origin + t * delta enters before maxFraction.
+	//maxFraction is re-read during the walk, so a visitor may lower it to cut off everything behind a hit
+	template<typename TVisitor>
+	void QuerySegment(sf::Vector2f origin, sf::Vector2f delta, const float& maxFraction, TVisitor&& visitor) const;
+
+private:
+
+	static constexpr int s_nodeCapacity = 8;
+
+	//level 0 (leaves): children are the shapes [first, first + count) of m_ids / the shape bounds,
+	//above: children are the nodes [first, first + count) of the level below
+	struct Node
+	{
+		CollisionAABB bounds;
+		int first = 0;
+		int count = 0;
+	};
+
+	CollisionAABB GetShapeBounds(int index) const { return { sf::Vector2f(m_minX[index], m_minY[index]), sf::Vector2f(m_maxX[index], m_maxY[index]) }; }
+
+	//orders bounds [0, count) into packing order: sorted by x into vertical slices, each slice sorted by y
+	void SortTileRecursive(const std::vector<CollisionAABB>& bounds, std::vector<int>& outOrder) const;
+
+	template<typename TVisitor>
+	void QueryNode(int nodeIndex, int level, const CollisionAABB& bounds, TVisitor& visitor) const;
+	template<typename TVisitor>
+	void QuerySegmentNode(int nodeIndex, int level, sf::Vector2f origin, sf::Vector2f delta, const float& maxFraction, TVisitor& visitor) const;
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_levelBegin; //first node of every level, the root is the last node
+	std::vector<int> m_ids;
+	std::vector<float> m_minX;
+	std::vector<float> m_minY;
+	std::vector<float> m_maxX;
+	std::vector<float> m_maxY;
+
+	//build scratch
+	std::vector<int> m_order;
+	std::vector<CollisionAABB> m_levelBounds;
+	std::vector<Node> m_levelNodes;
+};
+
+template<typename TVisitor>
+void StaticCollisionIndex::Query(const CollisionAABB& bounds, TVisitor&& visitor) const
+{
+	if (IsEmpty())
+		return;
+
+	QueryNode(static_cast<int>(m_nodes.size()) - 1, static_cast<int>(m_levelBegin.size()) - 1, bounds, visitor);
+}
+
+template<typename TVisitor>
+void StaticCollisionIndex::QueryNode(int nodeIndex, int level, const CollisionAABB& bounds, TVisitor& visitor) const
+{
+	const Node& node = m_nodes[nodeIndex];
+	if (!node.bounds.Intersects(bounds))
+		return;
+
+	if (level > 0)
+	{
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			QueryNode(i, level - 1, bounds, visitor);
+		}
+		return;
+	}
+
+	int hits[s_nodeCapacity];
+	const int hitCount = CollisionKernels::TestBoxBatch(bounds.min.x, bounds.min.y, bounds.max.x, bounds.max.y,
+		&m_minX[node.first], &m_minY[node.first], &m_maxX[node.first], &m_maxY[node.first], node.count, hits);
+
+	for (int h = 0; h < hitCount; h++)
+	{
+		visitor(m_ids[node.first + hits[h]]);
+	}
+}
+
+template<typename TVisitor>
+void StaticCollisionIndex::QuerySegment(sf::Vector2f origin, sf::Vector2f delta, const float& maxFraction, TVisitor&& visitor) const
+{
+	if (IsEmpty())
+		return;
+
+	QuerySegmentNode(static_cast<int>(m_nodes.size()) - 1, static_cast<int>(m_levelBegin.size()) - 1, origin, delta, maxFraction, visitor);
+}
+
+template<typename TVisitor>
+void StaticCollisionIndex::QuerySegmentNode(int nodeIndex, int level, sf::Vector2f origin, sf::Vector2f delta, const float& maxFraction, TVisitor& visitor) const
+{
+	float enter;
+	if (!m_nodes[nodeIndex].bounds.IntersectsSegment(origin, delta, maxFraction, enter))
+		return;
+
+	const Node& node = m_nodes[nodeIndex];
+	for (int i = node.first; i < node.first + node.count; i++)
+	{
+		if (level > 0)
+			QuerySegmentNode(i, level - 1, origin, delta, maxFraction, visitor);
+		else if (GetShapeBounds(i).IntersectsSegment(origin, delta, maxFraction, enter))
+			visitor(m_ids[i]);
+	}
+}
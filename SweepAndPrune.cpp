@@ -0,0 +1,106 @@
+#include "SweepAndPrune.h"
+
+#include "CollisionKernels.h"
+
+#include <algorithm>
+#include <limits>
+
+void SweepAndPrune::Build(const CollisionEntrySoA& shapes, const CollisionAABB& /*worldBounds*/)
+{
+	const int count = static_cast<int>(shapes.Size());
+
+	//removals shrank the dense range, registrations grew it
+	if (static_cast<int>(m_endpoints.size()) > count)
+	{
+		m_endpoints.erase(std::remove_if(m_endpoints.begin(), m_endpoints.end(), [count](const Endpoint& endpoint) { return endpoint.denseIndex >= count; }),
+			m_endpoints.end());
+	}
+
+	for (int denseIndex = static_cast<int>(m_endpoints.size()); denseIndex < count; denseIndex++)
+	{
+		Endpoint endpoint;
+		endpoint.denseIndex = denseIndex;
+		m_endpoints.push_back(endpoint);
+	}
+
+	//deleted shapes sort behind everything and are never reached by the sweep
+	for (Endpoint& endpoint : m_endpoints)
+	{
+		const int i = endpoint.denseIndex;
+		endpoint.minX = (shapes.flags[i] & COLLISION_FLAG_DELETED) ? std::numeric_limits<float>::infinity() : shapes.x[i] - shapes.radius[i];
+	}
+
+	InsertionSort();
+
+	m_maxX.resize(count);
+	m_x.resize(count);
+	m_y.resize(count);
+	m_radius.resize(count);
+	m_flags.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		const int denseIndex = m_endpoints[i].denseIndex;
+		m_maxX[i] = shapes.x[denseIndex] + shapes.radius[denseIndex];
+		m_x[i] = shapes.x[denseIndex];
+		m_y[i] = shapes.y[denseIndex];
+		m_radius[i] = shapes.radius[denseIndex];
+		m_flags[i] = shapes.flags[denseIndex];
+	}
+}
+
+void SweepAndPrune::InsertionSort()
+{
+	m_sortShiftCount = 0;
+
+	const int count = static_cast<int>(m_endpoints.size());
+	for (int i = 1; i < count; i++)
+	{
+		const Endpoint endpoint = m_endpoints[i];
+
+		int j = i;
+		while (j > 0 && m_endpoints[j - 1].minX > endpoint.minX)
+		{
+			m_endpoints[j] = m_endpoints[j - 1];
+			j--;
+		}
+
+		m_endpoints[j] = endpoint;
+		m_sortShiftCount += i - j;
+	}
+}
+
+void SweepAndPrune::GeneratePairs(std::vector<CollisionPair>& outPairs)
+{
+	outPairs.clear();
+	m_pairTestCount = 0;
+
+	const int count = static_cast<int>(m_endpoints.size());
+	if (m_kernelHits.size() < m_endpoints.size())
+		m_kernelHits.resize(m_endpoints.size());
+
+	for (int i = 0; i < count; i++)
+	{
+		if (m_flags[i] & COLLISION_FLAG_DELETED)
+			continue;
+
+		//the shapes whose x interval starts inside this one's
+		int end = i + 1;
+		while (end < count && m_endpoints[end].minX <= m_maxX[i])
+		{
+			end++;
+		}
+
+		const int rangeCount = end - (i + 1);
+		if (rangeCount == 0)
+			continue;
+
+		m_pairTestCount += rangeCount;
+		const int hitCount = CollisionKernels::TestCircleBatch(m_x[i], m_y[i], m_radius[i],
+			m_x.data() + i + 1, m_y.data() + i + 1, m_radius.data() + i + 1, rangeCount, m_kernelHits.data());
+
+		for (int hit = 0; hit < hitCount; hit++)
+		{
+			outPairs.push_back({ m_endpoints[i].denseIndex, m_endpoints[i + 1 + m_kernelHits[hit]].denseIndex });
+		}
+	}
+}
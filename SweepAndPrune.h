@@ -0,0 +1,49 @@
+#pragma once
+
+#include "BroadphaseBackend.h"
+
+#include <cstdint>
+#include <vector>
+
+//Sweep and prune along x with a persistent sorted endpoint list.
+//The order of the last Build is kept and re-sorted with insertion sort, with coherent motion between frames
+//that is close to linear. The sweep tests every shape against the following ones until their min endpoint
+//passes its max endpoint. Best for moderate counts spread along x; shapes lined up on one x sweep like brute force.
+class SweepAndPrune : public BroadphaseBackend
+{
+public:
+	//dense indices moved by the swap and pop removal re-sort from wherever they were, new ones from the end
+	void Build(const CollisionEntrySoA& shapes, const CollisionAABB& worldBounds) override;
+	void GeneratePairs(std::vector<CollisionPair>& outPairs) override;
+
+	//no nodes, the sorted list is the whole structure
+	int GetNodeCount() const override { return 0; }
+	long long GetPairTestCount() const override { return m_pairTestCount; }
+
+	//insertion sort moves of the last Build, ~0 for coherent frames
+	long long GetSortShiftCount() const { return m_sortShiftCount; }
+
+private:
+
+	struct Endpoint
+	{
+		float minX = 0.f;
+		int denseIndex = 0;
+	};
+
+	void InsertionSort();
+
+	//a permutation of the dense indices of the last Build, sorted by minX
+	std::vector<Endpoint> m_endpoints;
+	std::vector<int> m_kernelHits;
+
+	//hot data in sorted order
+	std::vector<float> m_maxX;
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_radius;
+	std::vector<uint8_t> m_flags;
+
+	long long m_sortShiftCount = 0;
+	long long m_pairTestCount = 0;
+};